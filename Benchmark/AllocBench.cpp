@@ -0,0 +1,76 @@
+#include <thread>
+#include <vector>
+#include "Benchmark.h"
+#include "PeriodicTaskScheduler.h"
+#include "Logger.h"
+
+using namespace std;
+using namespace PeriodicTaskScheduler;
+
+/*
+	task churn: the task objects `add_task` creates (task, timing and their control blocks)
+	are destroyed and created again and again, as auto-discovery adds and cancels tasks,
+	allocated from the heap as before against the slab used now for the task; counters 
+	count the calls of `operator new` made meanwhile
+*/
+
+namespace {
+	const size_t WORKING_SET = 1000;			/* tasks alive per churning thread */
+	const size_t CHURN_OPS = 100000;			/* tasks replaced per iteration, all threads */
+
+	float noop_work() { return 0.f; }
+
+	/* one churning thread: replace `ops` tasks of its working set, round robin */
+	template <bool Slab> void churn(size_t ops) {
+		vector<task_container_ptr> tasks(WORKING_SET);
+		auto clock = Clock::system();
+		for (size_t i = 0; i < ops; ++i) {
+			auto &t = tasks[i % WORKING_SET];
+			t = nullptr;
+			task_timing_ptr timing;
+			if (Slab) {
+				timing = make_shared<TaskTiming>();
+				t = allocate_shared<Task>(SlabAllocator<Task>(), clock, nullptr, nullptr, timing,
+					nullptr, hours(1), i + 1, noop_work, "bench");
+			}
+			else {
+				timing = make_shared<TaskTiming>();
+				t = task_container_ptr(new Task(clock, nullptr, nullptr, timing, nullptr, hours(1), i + 1,
+					noop_work, "bench"));
+			}
+		}
+	}
+
+	/* an iteration replaces `CHURN_OPS` tasks on `state.arg` threads */
+	template <bool Slab> void run_churn(Benchmark::State &state) {
+		size_t threads = state.arg ? state.arg : 1;
+		Logger::get().set_level(LOG_WARN);			/* no per-task lifecycle lines */
+		churn<Slab>(WORKING_SET);						/* warm up: slabs / heap arenas grown */
+		size_t before = Benchmark::process_rss_bytes();
+		auto allocs = Benchmark::heap_allocations();
+		while (state.running()) {
+			vector<thread> workers;
+			for (size_t i = 0; i < threads; ++i) { workers.emplace_back(churn<Slab>, CHURN_OPS / threads); }
+			for (auto &w : workers) { w.join(); }
+		}
+		allocs = Benchmark::heap_allocations() - allocs;		/* threads of the iterations too */
+		size_t after = Benchmark::process_rss_bytes();
+		double seconds = state.elapsed_ns() / 1e9, tasks = static_cast<double>(CHURN_OPS * state.iterations());
+		state.counters["tasks_per_sec"] = seconds > 0 ? tasks / seconds : 0;
+		state.counters["allocs_per_sec"] = seconds > 0 ? allocs / seconds : 0;
+		state.counters["allocs_per_task"] = allocs / tasks;
+		state.counters["rss_growth_bytes"] = static_cast<double>(after) - before;
+		Logger::get().set_level(LOG_INFO);
+	}
+}
+
+/* `arg` churning threads */
+void bench_task_churn_heap(Benchmark::State &state) {
+	run_churn<false>(state);
+}
+BENCHMARK_ITERATIONS(bench_task_churn_heap, 5, 1, 4);
+
+void bench_task_churn_slab(Benchmark::State &state) {
+	run_churn<true>(state);
+}
+BENCHMARK_ITERATIONS(bench_task_churn_slab, 5, 1, 4);
@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+#include <atomic>
+#include <new>
+#include "Benchmark.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#pragma warning(disable: 4996 )
+
+using namespace std;
+using namespace Benchmark;
+
+namespace {
+	atomic<unsigned long long> allocations{ 0 };	/* calls of `operator new` */
+}
+
+/* global allocation functions of the benchmark binary, counting every heap allocation */
+void *operator new(size_t n) {
+	allocations.fetch_add(1, memory_order_relaxed);
+	void *p = malloc(n ? n : 1);
+	if (!p) { throw bad_alloc(); }
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	free(p);
+}
+
+namespace {
+	struct bench_case {
+		string name;
+		bench_fn fn;
+		vector<size_t> args;
+		size_t iterations;
+	};
+	struct bench_result {
+		string name;
+		size_t iterations;
+		double ns_per_iter;
+		map<string, double> counters;
+	};
+
+	vector<bench_case> &registry() {
+		static vector<bench_case> cases;
+		return cases;
+	}
+
+	string json_escape(const string &s) {
+		string out;
+		char esc[8];
+		for (char c : s) {
+			if (static_cast<unsigned char>(c) < 0x20) {
+				snprintf(esc, sizeof(esc), "\\u%04x", static_cast<unsigned>(c));	/* control characters */
+				out += esc;
+				continue;
+			}
+			if (c == '"' || c == '\\') { out += '\\'; }
+			out += c;
+		}
+		return out;
+	}
+
+	/* run `c` once with `n` iterations */
+	State run_once(const bench_case &c, size_t arg, size_t n) {
+		State state(n, arg);
+		c.fn(state);
+		return state;
+	}
+}
+
+bool Benchmark::register_benchmark(const char *name, bench_fn fn, vector<size_t> args, size_t iterations) {
+	registry().push_back(bench_case{ name, fn, args, iterations });
+	return true;
+}
+
+unsigned long long Benchmark::heap_allocations() {
+	return allocations.load(memory_order_relaxed);
+}
+
+size_t Benchmark::process_rss_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+		return pmc.WorkingSetSize;
+	}
+	return 0;
+#else
+	unsigned long pages = 0, resident = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (!f) return 0;
+	if (fscanf(f, "%lu %lu", &pages, &resident) != 2) { resident = 0; }
+	fclose(f);
+	return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+double Benchmark::process_cpu_seconds() {
+#ifdef _WIN32
+	FILETIME created, exited, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+		return 0;
+	}
+	auto ticks = [](const FILETIME &t) {
+		return (static_cast<unsigned long long>(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+	};
+	return (ticks(kernel) + ticks(user)) / 1e7;		/* 100ns units */
+#else
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+/**
+	usage: Benchmark [--filter=<substring>] [--min_time=<seconds>] [--out=<file.json>]
+	prints a table to stderr and JSON results to stdout, or to `--out`
+*/
+int main(int argc, char **argv) {
+	string filter, out_path;
+	double min_time = 0.2;
+	for (int i = 1; i < argc; ++i) {
+		if (!strncmp(argv[i], "--filter=", 9)) filter = argv[i] + 9;
+		else if (!strncmp(argv[i], "--min_time=", 11)) min_time = atof(argv[i] + 11);
+		else if (!strncmp(argv[i], "--out=", 6)) out_path = argv[i] + 6;
+		else {
+			fprintf(stderr, "usage: %s [--filter=<substring>] [--min_time=<seconds>] [--out=<file>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	vector<bench_result> results;
+	fprintf(stderr, "%-48s %14s %14s\n", "benchmark", "iterations", "ns/iter");
+	for (auto &c : registry()) {
+		vector<size_t> args = c.args.empty() ? vector<size_t>{ 0 } : c.args;
+		for (size_t arg : args) {
+			string name = c.args.empty() ? c.name : c.name + "/" + to_string(arg);
+			if (!filter.empty() && name.find(filter) == string::npos) continue;
+
+			size_t n = c.iterations ? c.iterations : 1;
+			State state = run_once(c, arg, n);
+			// grow iteration count until a run takes `min_time`
+			while (!c.iterations && state.elapsed_ns() < min_time * 1e9 && n < 1000000000) {
+				double grow = state.elapsed_ns() > 0 ? min_time * 1e9 / state.elapsed_ns() * 1.4 : 10;
+				n = static_cast<size_t>(n * (grow < 2 ? 2 : grow > 100 ? 100 : grow));
+				state = run_once(c, arg, n);
+			}
+			bench_result r{ name, n, state.elapsed_ns() / n, state.counters };
+			fprintf(stderr, "%-48s %14zu %14.1f", name.c_str(), n, r.ns_per_iter);
+			for (auto &kv : r.counters) { fprintf(stderr, " %s=%g", kv.first.c_str(), kv.second); }
+			fprintf(stderr, "\n");
+			results.push_back(r);
+		}
+	}
+
+	FILE *out = out_path.empty() ? stdout : fopen(out_path.c_str(), "w");
+	if (!out) {
+		fprintf(stderr, "open %s failed\n", out_path.c_str());
+		return 1;
+	}
+	char date[32];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	fprintf(out, "{\n  \"context\": {\"date\": \"%s\", \"num_cpus\": %u, \"min_time\": %g},\n", 
+		date, thread::hardware_concurrency(), min_time);
+	fprintf(out, "  \"benchmarks\": [");
+	for (size_t i = 0; i < results.size(); ++i) {
+		auto &r = results[i];
+		fprintf(out, "%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"real_time\": %.3f, \"time_unit\": \"ns\"", 
+			i ? "," : "", json_escape(r.name).c_str(), r.iterations, r.ns_per_iter);
+		for (auto &kv : r.counters) { fprintf(out, ", \"%s\": %.6g", json_escape(kv.first).c_str(), kv.second); }
+		fprintf(out, "}");
+	}
+	fprintf(out, "\n  ]\n}\n");
+	if (out != stdout) { fclose(out); }
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <functional>
+
+namespace Benchmark {
+	/**
+		\description state of one benchmark run: the timed loop is 
+			while (state.running()) { ... }
+		only iterations inside the loop are timed, setup before and teardown after are not;
+		`pause_timing` / `resume_timing` exclude work inside the loop
+	*/
+	class State {
+		using clock = std::chrono::steady_clock;
+		size_t iterations_;
+		size_t done_;
+		bool started_;
+		bool paused_;
+		clock::time_point start_;
+		double elapsed_ns_;
+	public:
+		size_t arg;								/* argument of this run, 0 if none */
+		std::map<std::string, double> counters;		/* reported next to the timing */
+
+		State(size_t iterations, size_t arg) : iterations_(iterations), done_(0), 
+			started_(false), paused_(false), elapsed_ns_(0), arg(arg) {}
+
+		bool running() {
+			if (!started_) {
+				started_ = true;
+				start_ = clock::now();
+			}
+			if (done_ < iterations_) {
+				++done_;
+				return true;
+			}
+			pause_timing();
+			return false;
+		}
+		void pause_timing() {
+			if (paused_) return;
+			paused_ = true;
+			if (started_) {
+				elapsed_ns_ += std::chrono::duration<double, std::nano>(clock::now() - start_).count();
+			}
+			started_ = true;						/* paused before the loop */
+		}
+		void resume_timing() {
+			if (!paused_) return;
+			paused_ = false;
+			start_ = clock::now();
+		}
+		size_t iterations() const { return iterations_; }
+		double elapsed_ns() const { return elapsed_ns_; }
+	};
+
+	using bench_fn = std::function<void(State&)>;
+
+	/**
+		add a benchmark to the suite; run once per element of `args`
+
+		@param iterations			fixed iteration count, 0: grow until `--min_time`
+	*/
+	bool register_benchmark(const char *name, bench_fn fn, std::vector<size_t> args = {}, 
+		size_t iterations = 0);
+	/**
+		@return size_t				resident memory of this process in bytes, 0 if unknown
+	*/
+	size_t process_rss_bytes();
+	/**
+		@return unsigned long long	calls of the global `operator new` in this process so far,
+									counted by the replacement in Benchmark.cpp
+	*/
+	unsigned long long heap_allocations();
+	/**
+		@return double				user + system CPU time of this process so far, in seconds
+	*/
+	double process_cpu_seconds();
+}
+
+/* register `fn` at startup, e.g. BENCHMARK(bench_add_task, 1000, 10000) */
+#define BENCHMARK(fn, ...) \
+	static bool fn##_registered = Benchmark::register_benchmark(#fn, fn, { __VA_ARGS__ })
+/* same, with a fixed iteration count */
+#define BENCHMARK_ITERATIONS(fn, n, ...) \
+	static bool fn##_registered = Benchmark::register_benchmark(#fn, fn, { __VA_ARGS__ }, n)
+
+#endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "Benchmark.h"
+#include "Logger.h"
+
+#pragma warning(disable: 4996 )
+
+/*
+	cost of the per-iteration log line of `Task::run`, on the calling (task) thread
+*/
+
+namespace {
+	const char *NULL_DEVICE =
+#ifdef _WIN32
+		"NUL";
+#else
+		"/dev/null";
+#endif
+	const size_t CHUNK = LogBuffer::SLOTS / 2;		/* records logged between untimed flushes */
+
+	/* logger writing to the null device; the flusher thread is kept out of the way */
+	Logger &null_logger(log_level level, FILE *&f) {
+		Logger &logger = Logger::get();
+		f = fopen(NULL_DEVICE, "w");
+		logger.set_output(f);
+		logger.set_flush_interval(1000);
+		logger.set_level(level);
+		logger.flush();
+		return logger;
+	}
+	void restore_logger(Logger &logger, FILE *f) {
+		logger.flush();
+		logger.set_output(stdout);
+		logger.set_flush_interval(10);
+		logger.set_level(LOG_INFO);
+		fclose(f);
+	}
+}
+
+/* below level threshold: a relaxed load and a branch */
+void bench_log_disabled(Benchmark::State &state) {
+	FILE *f;
+	Logger &logger = null_logger(LOG_INFO, f);
+	size_t tid = 7, period = 2;
+	while (state.running()) {
+		log_debug("working...task id:%zd, period:%zd", tid, period);
+	}
+	restore_logger(logger, f);
+}
+BENCHMARK(bench_log_disabled);
+
+/* enabled: capture into the thread's buffer, formatting deferred */
+void bench_log_enabled(Benchmark::State &state) {
+	FILE *f;
+	Logger &logger = null_logger(LOG_DEBUG, f);
+	size_t tid = 7, period = 2, n = 0;
+	unsigned long long dropped = logger.dropped();
+	while (state.running()) {
+		log_debug("working...task id:%zd, period:%zd", tid, period);
+		if (++n % CHUNK == 0) {
+			state.pause_timing();
+			logger.flush();
+			state.resume_timing();
+		}
+	}
+	state.counters["dropped"] = static_cast<double>(logger.dropped() - dropped);
+	restore_logger(logger, f);
+}
+BENCHMARK(bench_log_enabled);
+
+/* enabled, with a copied task name */
+void bench_log_enabled_string(Benchmark::State &state) {
+	FILE *f;
+	Logger &logger = null_logger(LOG_DEBUG, f);
+	std::string name = "tcp google";
+	size_t n = 0;
+	while (state.running()) {
+		log_debug("table updated: tid:%zd, tname:%s, val:%f", n, name, 1.5f);
+		if (++n % CHUNK == 0) {
+			state.pause_timing();
+			logger.flush();
+			state.resume_timing();
+		}
+	}
+	restore_logger(logger, f);
+}
+BENCHMARK(bench_log_enabled_string);
+
+/* deferred cost on the flusher: format and write one record */
+void bench_log_flush(Benchmark::State &state) {
+	FILE *f;
+	Logger &logger = null_logger(LOG_DEBUG, f);
+	size_t tid = 7, period = 2, n = 0;
+	state.pause_timing();
+	while (state.running()) {
+		if (n++ % CHUNK == 0) {
+			for (size_t i = 0; i < CHUNK; ++i) { log_debug("working...task id:%zd, period:%zd", tid, period); }
+			state.resume_timing();
+			logger.flush();
+			state.pause_timing();
+		}
+	}
+	restore_logger(logger, f);
+}
+BENCHMARK(bench_log_flush);
+
+/* previous behaviour: synchronous printf through the stdio lock */
+void bench_log_printf(Benchmark::State &state) {
+	FILE *f = fopen(NULL_DEVICE, "w");
+	setvbuf(f, nullptr, _IONBF, 0);				/* as Test.cpp did for stdout */
+	size_t tid = 7, period = 2;
+	while (state.running()) {
+		fprintf(f, "working...task id:%zd, period:%zd \n", tid, period);
+	}
+	fclose(f);
+}
+BENCHMARK(bench_log_printf);
\ No newline at end of file
@@ -0,0 +1,555 @@
+#include <algorithm>
+#include "Benchmark.h"
+#include "PeriodicTaskScheduler.h"
+#include "ShardedScheduler.h"
+#include "Logger.h"
+
+using namespace std;
+using namespace PeriodicTaskScheduler;
+
+/*
+	control-plane throughput, memory per task and dispatch lateness of `TaskScheduler`, 
+	with synthetic work and a storage backend that discards results
+*/
+
+namespace {
+	/* accepts and drops every result, so that storage does not take part */
+	class NullBackend : public StorageBackend {
+	public:
+		virtual bool db_setup() { return true; }
+		virtual bool db_insert(size_t, const char*, float) { return true; }
+		virtual bool db_write(const StoreRecord*, size_t) { return true; }
+	};
+
+	using work_fn = float(*)();
+
+	float noop_work() { return 0.f; }
+	/* same, as a work type for `add_typed_task` */
+	struct noop_probe {
+		float operator()() { return 0.f; }
+	};
+
+	/* busy work of about `WORK_US` microseconds */
+	const long long WORK_US = 50;
+	float fixed_work() {
+		auto end = steady_clock::now() + microseconds(WORK_US);
+		while (steady_clock::now() < end);
+		return 1.f;
+	}
+
+	/* a scheduler of its own per benchmark, so that no state leaks into the next one */
+	task_scheduler_ptr setup(const affinity_config &affinity = affinity_config()) {
+		auto s = make_shared<TaskScheduler>();
+		Logger::get().set_level(LOG_WARN);			/* no per-task lifecycle lines */
+		s->set_affinity(affinity);
+		s->setup_context(make_shared<NullBackend>());
+		return s;
+	}
+
+	/* `period` in seconds or a `Clock::duration` */
+	template <class P>
+	vector<size_t> add_tasks(task_scheduler_ptr s, size_t n, P period, work_fn work) {
+		vector<size_t> tids;
+		tids.reserve(n);
+		for (size_t i = 0; i < n; ++i) { tids.push_back(s->add_task(period, work, "bench")); }
+		return tids;
+	}
+
+	void teardown(task_scheduler_ptr s) {
+		s->release_context();
+		Logger::get().set_level(LOG_INFO);
+	}
+}
+
+/* add_task into a scheduler holding `arg` tasks; tasks are not started */
+void bench_add_task(Benchmark::State &state) {
+	auto s = setup();
+	work_fn work = noop_work;
+	add_tasks(s, state.arg, 3600, work);
+	while (state.running()) {
+		s->add_task(3600, work, "bench");
+	}
+	teardown(s);
+}
+BENCHMARK_ITERATIONS(bench_add_task, 10000, 0, 10000);
+
+/* update_task, round robin over `arg` registered tasks */
+void bench_update_task(Benchmark::State &state) {
+	auto s = setup();
+	work_fn work = noop_work;
+	auto tids = add_tasks(s, state.arg, 3600, work);
+	size_t i = 0;
+	while (state.running()) {
+		s->update_task(3600 + (i & 1), tids[i % tids.size()]);
+		++i;
+	}
+	teardown(s);
+}
+BENCHMARK(bench_update_task, 1000, 10000);
+
+/* cancel_task of not started tasks, out of `arg` + iterations registered tasks */
+void bench_cancel_task(Benchmark::State &state) {
+	auto s = setup();
+	work_fn work = noop_work;
+	add_tasks(s, state.arg, 3600, work);
+	auto tids = add_tasks(s, state.iterations(), 3600, work);
+	size_t i = 0;
+	while (state.running()) {
+		s->cancel_task(tids[i++]);
+	}
+	teardown(s);
+}
+BENCHMARK_ITERATIONS(bench_cancel_task, 10000, 0, 10000);
+
+/* pause_task + resume_task, round robin over `arg` registered tasks */
+void bench_pause_resume(Benchmark::State &state) {
+	auto s = setup();
+	work_fn work = noop_work;
+	auto tids = add_tasks(s, state.arg, 3600, work);
+	size_t i = 0;
+	while (state.running()) {
+		size_t tid = tids[i++ % tids.size()];
+		s->pause_task(tid);
+		s->resume_task(tid);
+	}
+	teardown(s);
+}
+BENCHMARK(bench_pause_resume, 1000, 10000);
+
+/* same through the handles returned by `add_task`; counter: a stale handle is rejected 
+once its slot is reused */
+void bench_pause_resume_handle(Benchmark::State &state) {
+	auto s = setup();
+	work_fn work = noop_work;
+	vector<task_handle> handles;
+	for (size_t n = 0; n < state.arg; ++n) { handles.push_back(s->add_task(3600, work, "bench")); }
+	size_t i = 0;
+	while (state.running()) {
+		const task_handle &h = handles[i++ % handles.size()];
+		s->pause_task(h);
+		s->resume_task(h);
+	}
+	s->cancel_task(handles[0]);
+	s->add_task(3600, work, "bench");			/* reuses the slot */
+	state.counters["stale_rejected"] = s->pause_task(handles[0]) ? 0 : 1;
+	teardown(s);
+}
+BENCHMARK(bench_pause_resume_handle, 1000, 10000);
+
+/* resident memory per task, registered and then running */
+void bench_memory_per_task(Benchmark::State &state) {
+	auto s = setup();
+	work_fn work = noop_work;
+	size_t before = Benchmark::process_rss_bytes();
+	while (state.running()) {
+		add_tasks(s, state.arg, 3600, work);
+	}
+	size_t registered = Benchmark::process_rss_bytes();
+	s->start();
+	this_thread::sleep_for(seconds(2));
+	size_t running = Benchmark::process_rss_bytes();
+	state.counters["registered_bytes_per_task"] = (static_cast<double>(registered) - before) / state.arg;
+	state.counters["running_bytes_per_task"] = (static_cast<double>(running) - before) / state.arg;
+	teardown(s);
+}
+BENCHMARK_ITERATIONS(bench_memory_per_task, 1, 1000, 10000);
+
+/* 
+	lateness of dispatches of `arg` tasks of period 1s over `LATENESS_SECONDS`; an iteration
+	is one run. Registration stops after `ADD_BUDGET_SECONDS`, see `tasks_registered`.
+	Counters in microseconds
+*/
+const int LATENESS_SECONDS = 5;
+const int ADD_BUDGET_SECONDS = 60;
+void lateness_counters(Benchmark::State &state, const histogram_snapshot &h) {
+	state.counters["executions"] = static_cast<double>(h.count);
+	state.counters["executions_per_sec"] = static_cast<double>(h.count) / LATENESS_SECONDS;
+	state.counters["p50_us"] = static_cast<double>(h.percentile(50));
+	state.counters["p99_us"] = static_cast<double>(h.percentile(99));
+	state.counters["p999_us"] = static_cast<double>(h.percentile(99.9));
+	state.counters["max_us"] = static_cast<double>(h.max);
+}
+
+void run_lateness(Benchmark::State &state, work_fn work, bool typed = false, 
+	const affinity_config &affinity = affinity_config()) {
+	auto s = setup(affinity);
+	size_t registered = 0;
+	histogram_snapshot before, after;
+	while (state.running()) {
+		auto budget = steady_clock::now() + seconds(ADD_BUDGET_SECONDS);
+		for (; registered < state.arg && steady_clock::now() < budget; ++registered) {
+			if (typed) { s->add_typed_task(1, noop_probe(), "bench"); }
+			else { s->add_task(1, work, "bench"); }
+		}
+		before = s->get_timing().lateness;
+		s->start();
+		this_thread::sleep_for(seconds(LATENESS_SECONDS));
+		after = s->get_timing().lateness;
+	}
+	// this run only: scheduler-wide histograms include earlier runs
+	histogram_snapshot h = after.since(before);
+	vector<task_container_ptr> tasks;
+	s->copy_tasks(tasks);
+	size_t started = 0;
+	for (auto &t : tasks) { started += t->worker_joinable() ? 1 : 0; }
+	tasks.clear();
+	if (typed) { started = registered; }			/* all run on one pool thread */
+	state.counters["tasks_registered"] = static_cast<double>(registered);
+	state.counters["tasks_started"] = static_cast<double>(started);
+	lateness_counters(state, h);
+	teardown(s);
+}
+
+/* no-op work: scheduler overhead only */
+void bench_dispatch_lateness(Benchmark::State &state) {
+	run_lateness(state, noop_work);
+}
+BENCHMARK_ITERATIONS(bench_dispatch_lateness, 1, 1000, 10000, 100000);
+
+/* ~50us of busy work per execution */
+void bench_dispatch_lateness_fixed(Benchmark::State &state) {
+	run_lateness(state, fixed_work);
+}
+BENCHMARK_ITERATIONS(bench_dispatch_lateness_fixed, 1, 1000, 10000, 100000);
+
+/* no-op work of a type known at compile time: all tasks on one `TaskPool` thread */
+void bench_dispatch_lateness_typed(Benchmark::State &state) {
+	run_lateness(state, nullptr, true);
+}
+BENCHMARK_ITERATIONS(bench_dispatch_lateness_typed, 1, 1000, 10000, 100000);
+
+/* 
+	scheduler, storage and metrics threads pinned to the first CPU of NUMA node 0, task 
+	threads and pools to its other CPUs (all to the one CPU of a single CPU machine); 
+	to be compared with the unpinned `bench_dispatch_lateness(_typed)`
+*/
+affinity_config pinned_affinity() {
+	affinity_config cfg;
+	cpu_list node = Affinity::node_cpus(0);
+	if (node.empty()) {
+		return cfg;
+	}
+	cfg.dispatcher = cfg.storage = cfg.io = cpu_list{ node[0] };
+	cfg.workers = node.size() > 1 ? cpu_list(node.begin() + 1, node.end()) : node;
+	return cfg;
+}
+
+void bench_dispatch_lateness_pinned(Benchmark::State &state) {
+	run_lateness(state, noop_work, false, pinned_affinity());
+}
+BENCHMARK_ITERATIONS(bench_dispatch_lateness_pinned, 1, 1000, 10000);
+
+void bench_dispatch_lateness_typed_pinned(Benchmark::State &state) {
+	run_lateness(state, nullptr, true, pinned_affinity());
+}
+BENCHMARK_ITERATIONS(bench_dispatch_lateness_typed_pinned, 1, 1000, 10000, 100000);
+
+/* typed tasks on a `ShardedScheduler` with `affinity` */
+namespace {
+	void run_sharded(Benchmark::State &state, shard_affinity affinity) {
+		Logger::get().set_level(LOG_WARN);
+		ShardedScheduler s;
+		s.set_affinity(affinity);
+		s.setup_context([](size_t) -> db_handler_ptr { return make_shared<NullBackend>(); });
+		histogram_snapshot before, after;
+		while (state.running()) {
+			for (size_t i = 0; i < state.arg; ++i) { s.add_typed_task(1, noop_probe(), "bench"); }
+			before = s.get_timing().lateness;
+			s.start();
+			this_thread::sleep_for(seconds(LATENESS_SECONDS));
+			after = s.get_timing().lateness;
+		}
+		state.counters["shards"] = static_cast<double>(s.shards());
+		lateness_counters(state, after.since(before));
+		s.release_context();
+		Logger::get().set_level(LOG_INFO);
+	}
+}
+
+/* same, spread over a `ShardedScheduler` of one scheduler (one pool thread) per hardware thread */
+void bench_dispatch_lateness_sharded(Benchmark::State &state) {
+	run_sharded(state, SHARD_UNPINNED);
+}
+BENCHMARK_ITERATIONS(bench_dispatch_lateness_sharded, 1, 1000, 10000, 100000);
+
+/* same, shard i pinned to CPU i */
+void bench_dispatch_lateness_sharded_pinned(Benchmark::State &state) {
+	run_sharded(state, SHARD_PER_CORE);
+}
+BENCHMARK_ITERATIONS(bench_dispatch_lateness_sharded_pinned, 1, 1000, 10000, 100000);
+
+/*
+	finding the tasks due among `arg` tasks added one after the other, the first 1% due:
+	`TaskTable` summary + hot arrays against a scan of an array of per-task structs (as
+	`TaskPool` held before); counter: bytes of task state read per scan, per 1000 tasks
+*/
+const size_t DUE_PERCENT = 1;
+void bench_due_scan_table(Benchmark::State &state) {
+	TaskTable table;
+	auto base = steady_clock::time_point() + hours(1);
+	auto timing = make_shared<TaskTiming>();
+	auto name = make_shared<const string>("bench");
+	for (size_t i = 0; i < state.arg; ++i) {
+		table.insert(i + 1, seconds(1), base + microseconds(i), timing, name);
+	}
+	auto now = base + microseconds(state.arg * DUE_PERCENT / 100);
+	size_t due = 0;
+	while (state.running()) {
+		table.run_due(now, [&](uint32_t) { ++due; });
+	}
+	size_t due_blocks = (state.arg * DUE_PERCENT / 100) / TaskTable::BLOCK + 1;
+	size_t bytes = (state.arg / TaskTable::BLOCK + 1) * sizeof(TaskTable::rep) + 
+		due_blocks * TaskTable::BLOCK * (sizeof(TaskTable::rep) + 1);
+	state.counters["due"] = static_cast<double>(due / state.iterations());
+	state.counters["bytes_per_1k"] = bytes * 1000.0 / state.arg;
+}
+BENCHMARK(bench_due_scan_table, 1000, 10000, 100000);
+
+void bench_due_scan_struct(Benchmark::State &state) {
+	vector<pooled_task> tasks;
+	auto base = steady_clock::time_point() + hours(1);
+	auto timing = make_shared<TaskTiming>();
+	auto name = make_shared<const string>("bench");
+	for (size_t i = 0; i < state.arg; ++i) {
+		tasks.push_back(pooled_task{ i + 1, seconds(1), base + microseconds(i), false, timing, name });
+	}
+	auto now = base + microseconds(state.arg * DUE_PERCENT / 100);
+	size_t due = 0;
+	while (state.running()) {
+		for (auto &t : tasks) {
+			if (!t.paused && t.deadline <= now) { ++due; }
+		}
+	}
+	state.counters["due"] = static_cast<double>(due / state.iterations());
+	state.counters["bytes_per_1k"] = sizeof(pooled_task) * 1000.0;
+}
+BENCHMARK(bench_due_scan_struct, 1000, 10000, 100000);
+/*
+	`SIMULATED_SECONDS` of `arg` tasks of period 1s on a `VirtualClock`; counters: executions
+	(exactly arg * (SIMULATED_SECONDS + 1)), simulated seconds per real second and max
+	lateness (0: simulated timeline is exact)
+*/
+const int SIMULATED_SECONDS = 600;
+void bench_virtual_time(Benchmark::State &state) {
+	auto s = setup();
+	auto clock = make_shared<VirtualClock>();
+	s->set_clock(clock);
+	work_fn work = noop_work;
+	histogram_snapshot before, after;
+	while (state.running()) {
+		add_tasks(s, state.arg, 1, work);
+		before = s->get_timing().lateness;
+		s->start();
+		clock->advance_for(seconds(SIMULATED_SECONDS));
+		after = s->get_timing().lateness;
+	}
+	histogram_snapshot h = after.since(before);
+	state.counters["executions"] = static_cast<double>(h.count);
+	state.counters["speedup"] = SIMULATED_SECONDS / (state.elapsed_ns() / 1e9);
+	state.counters["max_lateness_us"] = static_cast<double>(h.max);
+	teardown(s);
+}
+BENCHMARK_ITERATIONS(bench_virtual_time, 1, 10, 100, 1000);
+
+/*
+	load over the period of `arg` typed tasks of period 1s added at once, on a `VirtualClock`
+	for `PHASE_SECONDS`, by phase policy; counters: executions per 1ms of the period, peak and
+	mean, and the fraction of milliseconds with any execution (1: load flat)
+*/
+const int PHASE_SECONDS = 10;
+namespace {
+	/* executions by millisecond of the (1s) period */
+	class PhaseSink : public ResultSink {
+	public:
+		atomic<uint32_t> per_ms[1000];
+		PhaseSink() { reset(); }
+		void reset() { for (auto &c : per_ms) { c = 0; } }
+		virtual void publish(const ResultRecord &r) { ++per_ms[r.timestamp % 1000]; }
+	};
+
+	void run_phase(Benchmark::State &state, phase_policy policy, bool rebalance = false) {
+		auto s = setup();
+		auto clock = make_shared<VirtualClock>();
+		auto sink = make_shared<PhaseSink>();
+		s->set_clock(clock);
+		s->set_phase_policy(policy);
+		s->add_sink(sink);
+		while (state.running()) {
+			for (size_t i = 0; i < state.arg; ++i) { s->add_typed_task(1, noop_probe(), "bench"); }
+			s->start();
+			if (rebalance) {
+				clock->advance_for(seconds(1));
+				s->rebalance();
+			}
+			sink->reset();
+			clock->advance_for(seconds(PHASE_SECONDS));
+		}
+		uint32_t peak = 0, busy = 0;
+		uint64_t total = 0;
+		for (auto &c : sink->per_ms) {
+			peak = max(peak, c.load());
+			busy += c ? 1 : 0;
+			total += c;
+		}
+		state.counters["peak_per_ms"] = static_cast<double>(peak) / PHASE_SECONDS;
+		state.counters["mean_per_ms"] = static_cast<double>(total) / PHASE_SECONDS / 1000;
+		state.counters["busy_ms_fraction"] = busy / 1000.0;
+		s->remove_sink(sink);
+		s->set_phase_policy(PHASE_NONE);
+		teardown(s);
+	}
+}
+
+/* all first run at once, and stay together */
+void bench_phase_none(Benchmark::State &state) {
+	run_phase(state, PHASE_NONE);
+}
+BENCHMARK_ITERATIONS(bench_phase_none, 1, 1000, 10000);
+
+void bench_phase_hash(Benchmark::State &state) {
+	run_phase(state, PHASE_HASH);
+}
+BENCHMARK_ITERATIONS(bench_phase_hash, 1, 1000, 10000);
+
+void bench_phase_spread(Benchmark::State &state) {
+	run_phase(state, PHASE_SPREAD);
+}
+BENCHMARK_ITERATIONS(bench_phase_spread, 1, 1000, 10000);
+
+/* added without phase, `rebalance`d after the first second */
+void bench_phase_rebalance(Benchmark::State &state) {
+	run_phase(state, PHASE_NONE, true);
+}
+BENCHMARK_ITERATIONS(bench_phase_rebalance, 1, 1000, 10000);
+
+/*
+	wakeups of `arg` tasks of period 1s, spread over the period (PHASE_SPREAD), on a 
+	`VirtualClock` for `SLACK_SECONDS`, without slack and with +-5% of the period; counters: 
+	wakeups per second (threads woken by their deadline) and wake instants per second 
+	(distinct times, what wakes an idle CPU), executions per second
+*/
+const int SLACK_SECONDS = 10;
+namespace {
+	void run_slack(Benchmark::State &state, const task_slack &slack, bool typed) {
+		auto s = setup();
+		auto clock = make_shared<VirtualClock>();
+		s->set_clock(clock);
+		s->set_phase_policy(PHASE_SPREAD);
+		s->set_default_slack(slack);
+		unsigned long long wakeups = 0, instants = 0, executions = 0;
+		while (state.running()) {
+			for (size_t i = 0; i < state.arg; ++i) {
+				if (typed) { s->add_typed_task(1, noop_probe(), "bench"); }
+				else { s->add_task(1, noop_work, "bench"); }
+			}
+			s->start();
+			clock->advance_for(seconds(1));
+			auto w = clock->wakeups(), n = clock->wake_instants();
+			auto e = s->get_timing().lateness.count;
+			clock->advance_for(seconds(SLACK_SECONDS));
+			wakeups += clock->wakeups() - w;
+			instants += clock->wake_instants() - n;
+			executions += s->get_timing().lateness.count - e;
+		}
+		double runs = static_cast<double>(state.iterations()) * SLACK_SECONDS;
+		state.counters["wakeups_per_sec"] = wakeups / runs;
+		state.counters["wake_instants_per_sec"] = instants / runs;
+		state.counters["executions_per_sec"] = executions / runs;
+		s->set_default_slack(NO_SLACK);
+		s->set_phase_policy(PHASE_NONE);
+		teardown(s);
+	}
+}
+
+void bench_slack_none(Benchmark::State &state) {
+	run_slack(state, NO_SLACK, false);
+}
+BENCHMARK_ITERATIONS(bench_slack_none, 1, 100, 1000);
+
+void bench_slack_5pct(Benchmark::State &state) {
+	run_slack(state, task_slack{ .05f, Clock::duration::zero() }, false);
+}
+BENCHMARK_ITERATIONS(bench_slack_5pct, 1, 100, 1000);
+
+void bench_slack_none_typed(Benchmark::State &state) {
+	run_slack(state, NO_SLACK, true);
+}
+BENCHMARK_ITERATIONS(bench_slack_none_typed, 1, 1000, 10000);
+
+void bench_slack_5pct_typed(Benchmark::State &state) {
+	run_slack(state, task_slack{ .05f, Clock::duration::zero() }, true);
+}
+BENCHMARK_ITERATIONS(bench_slack_5pct_typed, 1, 1000, 10000);
+
+/*
+	CPU used by the whole process over `IDLE_SECONDS` of real time with `arg` thread tasks 
+	and `arg` typed tasks registered and started, all of period 1h: nothing is due, so all 
+	threads should sleep; counter: percent of one CPU
+*/
+const int IDLE_SECONDS = 2;
+void bench_idle_cpu(Benchmark::State &state) {
+	auto s = setup();
+	work_fn work = noop_work;
+	add_tasks(s, state.arg, 3600, work);
+	for (size_t i = 0; i < state.arg; ++i) { s->add_typed_task(3600, noop_probe(), "bench"); }
+	s->start();
+	this_thread::sleep_for(milliseconds(500));		/* tasks started and ran once */
+	double cpu = 0;
+	while (state.running()) {
+		double before = Benchmark::process_cpu_seconds();
+		this_thread::sleep_for(seconds(IDLE_SECONDS));
+		cpu += Benchmark::process_cpu_seconds() - before;
+	}
+	state.counters["cpu_percent"] = 100 * cpu / (IDLE_SECONDS * state.iterations());
+	teardown(s);
+}
+BENCHMARK_ITERATIONS(bench_idle_cpu, 1, 0, 100, 1000);
+
+/*
+	lateness of `arg` thread tasks of period 1s over `LATENESS_SECONDS`, with plain waits 
+	and in precision mode (spinning the last 200us, timer slack 1us, SCHED_FIFO where 
+	permitted); counters: lateness percentiles and CPU of the process, in percent of one CPU.
+	The `_ms` variants run `PRECISION_TASKS` tasks of period `arg` milliseconds
+*/
+const size_t PRECISION_TASKS = 10;
+namespace {
+	void run_precision(Benchmark::State &state, const precision_config &cfg, size_t tasks, 
+		Clock::duration period) {
+		auto s = setup();
+		work_fn work = noop_work;
+		histogram_snapshot before, after;
+		double cpu = 0;
+		while (state.running()) {
+			for (auto tid : add_tasks(s, tasks, period, work)) { s->set_precision(tid, cfg); }
+			before = s->get_timing().lateness;
+			double cpu_before = Benchmark::process_cpu_seconds();
+			s->start();
+			this_thread::sleep_for(seconds(LATENESS_SECONDS));
+			cpu += Benchmark::process_cpu_seconds() - cpu_before;
+			after = s->get_timing().lateness;
+		}
+		lateness_counters(state, after.since(before));
+		state.counters["cpu_percent"] = 100 * cpu / (LATENESS_SECONDS * state.iterations());
+		teardown(s);
+	}
+}
+
+void bench_precision_off(Benchmark::State &state) {
+	run_precision(state, precision_config{ 0, 0, 0 }, state.arg, seconds(1));
+}
+BENCHMARK_ITERATIONS(bench_precision_off, 1, 1, 10);
+
+void bench_precision_spin(Benchmark::State &state) {
+	run_precision(state, precision_config{ 200, 1, 1000 }, state.arg, seconds(1));
+}
+BENCHMARK_ITERATIONS(bench_precision_spin, 1, 1, 10);
+
+void bench_precision_off_ms(Benchmark::State &state) {
+	run_precision(state, precision_config{ 0, 0, 0 }, PRECISION_TASKS, milliseconds(state.arg));
+}
+BENCHMARK_ITERATIONS(bench_precision_off_ms, 1, 1, 2, 5, 10);
+
+void bench_precision_spin_ms(Benchmark::State &state) {
+	run_precision(state, precision_config{ 200, 1, 1000 }, PRECISION_TASKS, milliseconds(state.arg));
+}
+BENCHMARK_ITERATIONS(bench_precision_spin_ms, 1, 1, 2, 5, 10);
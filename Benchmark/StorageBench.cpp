@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "Benchmark.h"
+#include "DBHandler.h"
+#include "SegmentStore.h"
+#include "Histogram.h"
+
+#pragma warning(disable: 4996 )
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	insert throughput, call latency and disk footprint of storage backends, driven with
+	synthetic result streams; every run starts from an empty database / directory in the
+	working directory. Each benchmark sweeps one dimension of the stream (history already
+	stored, number of tasks, batch size, concurrent writers) around `BASE_SHAPE`
+*/
+
+namespace {
+	using backend_ptr = shared_ptr<StorageBackend>;
+
+	/* backend under test; add an entry to `BACKENDS` to benchmark another sink */
+	struct store_backend {
+		const char *name;
+		function<backend_ptr(const string &path)> open;		/* new backend, set up */
+		function<unsigned long long(StorageBackend &db, const string &path)> bytes;	/* on disk */
+		function<void(const string &path)> remove;			/* delete what `open` created */
+	};
+
+	unsigned long long file_size(const string &path) {
+		FILE *f = fopen(path.c_str(), "rb");
+		if (!f) return 0;
+		fseek(f, 0, SEEK_END);
+		long n = ftell(f);
+		fclose(f);
+		return n > 0 ? static_cast<unsigned long long>(n) : 0;
+	}
+
+	/* segment files are listed in the manifest; the (empty) directory is kept */
+	void remove_segments(const string &dir) {
+		string idx = dir + "/segments.idx";
+		if (FILE *f = fopen(idx.c_str(), "r")) {
+			char name[256];
+			while (fscanf(f, "%255s", name) == 1) { ::remove((dir + "/" + name).c_str()); }
+			fclose(f);
+		}
+		::remove(idx.c_str());
+	}
+
+	const store_backend BACKENDS[] = {
+		{ "sqlite",
+			[](const string &path) {
+				backend_ptr db(new SQLiteHandler(path.c_str()));
+				return db->db_setup() ? db : nullptr;
+			},
+			[](StorageBackend&, const string &path) { return file_size(path); },
+			[](const string &path) { ::remove(path.c_str()); } },
+		{ "segment",
+			[](const string &path) {
+				backend_ptr db(new SegmentStore(path.c_str()));
+				return db->db_setup() ? db : nullptr;
+			},
+			[](StorageBackend &db, const string&) {
+				auto &store = static_cast<SegmentStore&>(db);
+				store.seal_all();
+				return store.bytes_on_disk();
+			},
+			remove_segments },
+	};
+
+	/* synthetic result stream */
+	struct stream_shape {
+		size_t tasks;						/* distinct task ids */
+		size_t history;						/* points per task stored before the timed run */
+		size_t batch;						/* records per `db_write`; 0: `db_insert` one by one */
+		size_t threads;						/* concurrent writers */
+		size_t records;						/* records written in the timed run */
+	};
+	const stream_shape BASE_SHAPE = { 100, 0, 64, 1, 50000 };
+
+	/* results of one task: 1s period, ping-like values, running aggregates */
+	class task_stream {
+		size_t tid_;
+		unsigned long long time_;
+		uint32_t seed_;
+		TaskAggregate agg_{ 0, 0, 0, 0 };
+		shared_ptr<const string> name_;
+	public:
+		task_stream(size_t tid) : tid_(tid), time_(1500000000000ull), 
+			seed_(static_cast<uint32_t>(tid) * 2654435761u + 1), name_(make_shared<const string>("bench " + to_string(tid))) {}
+
+		StoreRecord next() {
+			seed_ = seed_ * 1664525u + 1013904223u;
+			float value = 20.f + static_cast<float>(seed_ >> 24) / 64.f;
+			if (!agg_.count++) { agg_.minv = agg_.maxv = agg_.avgv = value; }
+			else {
+				agg_.minv = min(agg_.minv, value);
+				agg_.maxv = max(agg_.maxv, value);
+				agg_.avgv += (value - agg_.avgv) / agg_.count;
+			}
+			time_ += 1000;
+			return StoreRecord{ tid_, time_, value, agg_, name_ };
+		}
+	};
+
+	/* inserts/s of the first run of each history sweep, see `slowdown` */
+	map<string, double> &history_baseline() {
+		static map<string, double> rates;
+		return rates;
+	}
+
+	/**
+		write `shape.records` records with `shape.threads` writers, after `shape.history`
+		points per task were stored untimed; writer `k` takes every `threads`-th record.
+		Counters: inserts_per_sec, p50/p99 of one call (`db_insert` or `db_write` of a batch),
+		bytes on disk per stored point. With `baseline`, `slowdown` is the throughput of
+		the sweep's first run (empty table) over this one: ~1 if inserts do not depend
+		on history
+	*/
+	void run_stream(Benchmark::State &state, const store_backend &b, const stream_shape &shape,
+		const string &baseline = "") {
+		string path = string("bench_store_") + b.name;
+		b.remove(path);
+		backend_ptr db = b.open(path);
+		if (!db) {
+			state.counters["failed"] = static_cast<double>(shape.records);
+			while (state.running());
+			return;
+		}
+		vector<task_stream> tasks;
+		tasks.reserve(shape.tasks);
+		for (size_t i = 0; i < shape.tasks; ++i) { tasks.emplace_back(i + 1); }
+
+		vector<StoreRecord> buf;
+		for (size_t h = 0; h < shape.history; ++h) {
+			for (auto &t : tasks) { buf.push_back(t.next()); }
+			if (buf.size() >= 4096 || h + 1 == shape.history) {
+				db->db_write(buf.data(), buf.size());
+				buf.clear();
+			}
+		}
+		vector<vector<StoreRecord>> streams(shape.threads);
+		for (size_t i = 0; i < shape.records; ++i) {
+			streams[i % shape.threads].push_back(tasks[i % shape.tasks].next());
+		}
+
+		LatencyHistogram latency;			/* per call, in nanoseconds */
+		atomic<unsigned long long> failed{ 0 };
+		while (state.running()) {
+			vector<thread> writers;
+			for (auto &stream : streams) {
+				const vector<StoreRecord> &recs = stream;
+				writers.emplace_back([&db, &shape, &latency, &failed, &recs] {
+					size_t step = shape.batch ? shape.batch : 1;
+					for (size_t i = 0; i < recs.size(); i += step) {
+						size_t n = min(step, recs.size() - i);
+						auto start = steady_clock::now();
+						bool ok = shape.batch ? db->db_write(&recs[i], n) :
+							db->db_insert(recs[i].tid, recs[i].name->c_str(), recs[i].value);
+						latency.record(static_cast<unsigned long long>(
+							duration_cast<nanoseconds>(steady_clock::now() - start).count()));
+						if (!ok) { failed += n; }
+					}
+				});
+			}
+			for (auto &w : writers) { w.join(); }
+		}
+		double rate = shape.records / (state.elapsed_ns() / state.iterations() / 1e9);
+		double points = static_cast<double>(shape.tasks * shape.history + shape.records);
+		double p[] = { 50, 99 };
+		unsigned long long q[2];
+		latency.quantiles(p, q, 2);
+
+		state.counters["inserts_per_sec"] = rate;
+		state.counters["p50_call_us"] = q[0] / 1000.0;
+		state.counters["p99_call_us"] = q[1] / 1000.0;
+		state.counters["bytes_per_point"] = b.bytes(*db, path) / points;
+		state.counters["failed"] = static_cast<double>(failed.load());
+		if (!baseline.empty()) {
+			auto &base = history_baseline();
+			if (!shape.history) { base[baseline] = rate; }
+			else if (base.count(baseline)) { state.counters["slowdown"] = base[baseline] / rate; }
+		}
+		db = nullptr;
+		b.remove(path);
+	}
+
+	/* one benchmark per backend and swept dimension: bench_store_<backend>_<dimension>/<value> */
+	bool register_storage_benchmarks() {
+		for (const store_backend &b : BACKENDS) {
+			string prefix = string("bench_store_") + b.name + "_";
+			const store_backend *pb = &b;
+
+			// one by one through `db_insert`, history of 10 tasks
+			Benchmark::register_benchmark((prefix + "history_insert").c_str(), [pb](Benchmark::State &s) {
+				stream_shape shape = BASE_SHAPE;
+				shape.tasks = 10, shape.batch = 0, shape.history = s.arg, shape.records = 500;
+				run_stream(s, *pb, shape, string(pb->name) + "_insert");
+			}, { 0, 1000, 10000 }, 1);
+			// batches through `db_write`, as the storage pipeline does
+			Benchmark::register_benchmark((prefix + "history_write").c_str(), [pb](Benchmark::State &s) {
+				stream_shape shape = BASE_SHAPE;
+				shape.tasks = 10, shape.history = s.arg;
+				run_stream(s, *pb, shape, string(pb->name) + "_write");
+			}, { 0, 10000, 100000 }, 1);
+			Benchmark::register_benchmark((prefix + "tasks").c_str(), [pb](Benchmark::State &s) {
+				stream_shape shape = BASE_SHAPE;
+				shape.tasks = s.arg;
+				run_stream(s, *pb, shape);
+			}, { 1, 100, 10000 }, 1);
+			// batch 1 is a transaction per record for SQLite
+			Benchmark::register_benchmark((prefix + "batch").c_str(), [pb](Benchmark::State &s) {
+				stream_shape shape = BASE_SHAPE;
+				shape.batch = s.arg, shape.records = max<size_t>(2000, s.arg * 200);
+				run_stream(s, *pb, shape);
+			}, { 1, 16, 256 }, 1);
+			Benchmark::register_benchmark((prefix + "threads").c_str(), [pb](Benchmark::State &s) {
+				stream_shape shape = BASE_SHAPE;
+				shape.threads = s.arg;
+				run_stream(s, *pb, shape);
+			}, { 1, 2, 8 }, 1);
+		}
+		return true;
+	}
+	bool storage_registered = register_storage_benchmarks();
+}
@@ -0,0 +1,83 @@
+#include <vector>
+#include "Benchmark.h"
+#include "PeriodicTaskScheduler.h"
+
+using namespace std;
+using namespace PeriodicTaskScheduler;
+
+/*
+	construction and call cost of the task work wrapper, `task_work` against the previous
+	`std::function`, for probe closures of 8 to 128 bytes
+*/
+
+namespace {
+	/* closure of `N` bytes of captured state, as a lambda capturing a probe's target,
+	counters and handles would be */
+	template <size_t N> struct probe {
+		unsigned char state[N];
+		probe() { for (size_t i = 0; i < N; ++i) state[i] = static_cast<unsigned char>(i); }
+		float operator()() { return static_cast<float>(++state[N - 1]); }
+	};
+
+	const size_t SLOTS = 64;					/* wrappers assigned round robin */
+
+	/* move-assign a fresh wrapper into a slot: construction of the new and destruction
+	of the previous one */
+	template <class W, size_t N> void construct(Benchmark::State &state) {
+		vector<W> slots(SLOTS);
+		size_t i = 0;
+		while (state.running()) {
+			slots[i++ % SLOTS] = W(probe<N>());
+		}
+		state.counters["closure_bytes"] = static_cast<double>(sizeof(probe<N>));
+	}
+
+	template <class W, size_t N> void call(Benchmark::State &state) {
+		vector<W> slots;
+		for (size_t i = 0; i < SLOTS; ++i) { slots.emplace_back(probe<N>()); }
+		size_t i = 0;
+		float sum = 0;
+		while (state.running()) {
+			sum += slots[i++ % SLOTS]();
+		}
+		state.counters["sum"] = sum;			/* keeps the calls */
+	}
+
+	using bench_fn = void(*)(Benchmark::State&);
+
+	/* runs the instance for `state.arg` closure bytes */
+	void dispatch(Benchmark::State &state, bench_fn b8, bench_fn b32, bench_fn b56, bench_fn b128) {
+		switch (state.arg) {
+		case 8: b8(state); break;
+		case 32: b32(state); break;
+		case 56: b56(state); break;
+		default: b128(state); break;
+		}
+	}
+}
+
+/* construct + destroy, with `arg` bytes captured */
+void bench_work_construct_std_function(Benchmark::State &state) {
+	dispatch(state, construct<task_work_ptr, 8>, construct<task_work_ptr, 32>,
+		construct<task_work_ptr, 56>, construct<task_work_ptr, 128>);
+}
+BENCHMARK(bench_work_construct_std_function, 8, 32, 56, 128);
+
+void bench_work_construct_task_work(Benchmark::State &state) {
+	dispatch(state, construct<task_work, 8>, construct<task_work, 32>,
+		construct<task_work, 56>, construct<task_work, 128>);
+}
+BENCHMARK(bench_work_construct_task_work, 8, 32, 56, 128);
+
+/* one call of a stored closure of `arg` bytes */
+void bench_work_call_std_function(Benchmark::State &state) {
+	dispatch(state, call<task_work_ptr, 8>, call<task_work_ptr, 32>,
+		call<task_work_ptr, 56>, call<task_work_ptr, 128>);
+}
+BENCHMARK(bench_work_call_std_function, 8, 32, 56, 128);
+
+void bench_work_call_task_work(Benchmark::State &state) {
+	dispatch(state, call<task_work, 8>, call<task_work, 32>,
+		call<task_work, 56>, call<task_work, 128>);
+}
+BENCHMARK(bench_work_call_task_work, 8, 32, 56, 128);
@@ -0,0 +1,239 @@
+#include "Affinity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/prctl.h>
+#endif
+#endif
+
+#pragma warning(disable: 4996 )
+
+namespace {
+	const int MPOL_PREFERRED_ = 1;			/* <numaif.h>, without linking libnuma */
+	const unsigned MPOL_MF_MOVE_ = 1 << 1;
+
+	/* "0-3,8" into `out`, appended */
+	bool parse_list(const char *s, cpu_list &out) {
+		while (*s) {
+			char *end;
+			long first = strtol(s, &end, 10), last = first;
+			if (end == s || first < 0) return false;
+			s = end;
+			if (*s == '-') {
+				last = strtol(++s, &end, 10);
+				if (end == s || last < first) return false;
+				s = end;
+			}
+			for (long c = first; c <= last; ++c) { out.push_back(static_cast<int>(c)); }
+			if (*s == ',') ++s;
+			else if (*s && *s != '\n') return false;
+			else break;
+		}
+		return true;
+	}
+}
+
+/*
+	implementation of \class Affinity
+*/
+
+bool Affinity::parse(const char *spec, cpu_list &out) {
+	out.clear();
+	if (!strncmp(spec, "node:", 5)) {
+		char *end;
+		long node = strtol(spec + 5, &end, 10);
+		if (end == spec + 5 || *end || node < 0) return false;
+		out = node_cpus(static_cast<int>(node));
+		return !out.empty();
+	}
+	return parse_list(spec, out) && !out.empty();
+}
+
+std::string Affinity::to_string(const cpu_list &cpus) {
+	std::string s;
+	for (size_t i = 0; i < cpus.size(); ) {
+		size_t j = i;
+		while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+		if (!s.empty()) s += ',';
+		s += std::to_string(cpus[i]);
+		if (j > i) { s += '-'; s += std::to_string(cpus[j]); }
+		i = j + 1;
+	}
+	return s;
+}
+
+int Affinity::node_of(const cpu_list &cpus) {
+	if (cpus.empty()) return -1;
+	for (int n = 0; n < node_count(); ++n) {
+		cpu_list node = node_cpus(n);
+		bool all = true;
+		for (int c : cpus) {
+			bool found = false;
+			for (int d : node) { if (c == d) { found = true; break; } }
+			if (!found) { all = false; break; }
+		}
+		if (all) return n;
+	}
+	return -1;
+}
+
+#ifdef _WIN32
+
+bool Affinity::pin_thread(const cpu_list &cpus) {
+	if (cpus.empty()) return true;
+	DWORD_PTR mask = 0;
+	for (int c : cpus) {
+		if (c < 0 || c >= static_cast<int>(sizeof(mask) * 8)) return false;	/* group 0 only */
+		mask |= static_cast<DWORD_PTR>(1) << c;
+	}
+	// memory of the thread is allocated on the node of its processor by default
+	return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+int Affinity::node_count() {
+	ULONG highest = 0;
+	return GetNumaHighestNodeNumber(&highest) ? static_cast<int>(highest) + 1 : 1;
+}
+
+cpu_list Affinity::node_cpus(int node) {
+	cpu_list cpus;
+	ULONGLONG mask = 0;
+	if (node < 0 || node > 255 || !GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask)) {
+		return cpus;
+	}
+	for (int c = 0; c < 64; ++c) {
+		if (mask & (1ull << c)) { cpus.push_back(c); }
+	}
+	return cpus;
+}
+
+bool Affinity::prefer_node(const void*, size_t, int node) {
+	return node < 0;						/* placed at allocation only (VirtualAllocExNuma) */
+}
+
+void *Affinity::alloc_pages(size_t bytes) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	size_t page = info.dwPageSize;
+	return _aligned_malloc((bytes + page - 1) / page * page, page);
+}
+
+void Affinity::free_pages(void *p) {
+	_aligned_free(p);
+}
+
+bool Affinity::set_realtime(int priority) {
+	return SetThreadPriority(GetCurrentThread(), 
+		priority > 0 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL) != 0;
+}
+
+bool Affinity::set_timer_slack(long long) {
+	return false;							/* timer resolution is process-wide (timeBeginPeriod) */
+}
+
+#else
+
+int Affinity::node_count() {
+	int n = 0;
+	char path[64];
+	for (;; ++n) {
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", n);
+		if (access(path, F_OK)) break;
+	}
+	return n ? n : 1;
+}
+
+cpu_list Affinity::node_cpus(int node) {
+	cpu_list cpus;
+	char path[80], line[4096];
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+	if (FILE *f = fopen(path, "r")) {
+		if (!fgets(line, sizeof(line), f) || !parse_list(line, cpus)) { cpus.clear(); }
+		fclose(f);
+	}
+	else if (node == 0) {					/* no NUMA: one node of all CPUs */
+		for (unsigned c = 0; c < std::thread::hardware_concurrency(); ++c) {
+			cpus.push_back(static_cast<int>(c));
+		}
+	}
+	return cpus;
+}
+
+void *Affinity::alloc_pages(size_t bytes) {
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	void *p = nullptr;
+	return posix_memalign(&p, page, (bytes + page - 1) / page * page) ? nullptr : p;
+}
+
+void Affinity::free_pages(void *p) {
+	free(p);
+}
+
+bool Affinity::set_realtime(int priority) {
+	sched_param param;
+	param.sched_priority = priority > 0 ? priority : 0;
+	return !pthread_setschedparam(pthread_self(), priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param);
+}
+
+#ifdef __linux__
+
+bool Affinity::pin_thread(const cpu_list &cpus) {
+	if (cpus.empty()) return true;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int c : cpus) {
+		if (c < 0 || c >= CPU_SETSIZE) return false;
+		CPU_SET(c, &set);
+	}
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) return false;
+	int node = node_of(cpus);
+	if (node >= 0 && node < 64) {
+		// first touch by this thread places pages on its node (fails quietly without NUMA)
+		unsigned long mask = 1ul << node;
+		syscall(SYS_set_mempolicy, MPOL_PREFERRED_, &mask, sizeof(mask) * 8 + 1);
+	}
+	return true;
+}
+
+bool Affinity::prefer_node(const void *p, size_t bytes, int node) {
+	if (node < 0) return true;
+	if (!p || !bytes || node >= 64) return false;
+	uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+	uintptr_t begin = reinterpret_cast<uintptr_t>(p) & ~(page - 1);
+	uintptr_t end = (reinterpret_cast<uintptr_t>(p) + bytes + page - 1) & ~(page - 1);
+	unsigned long mask = 1ul << node;
+	return !syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED_, &mask, sizeof(mask) * 8 + 1,
+		MPOL_MF_MOVE_);
+}
+
+bool Affinity::set_timer_slack(long long ns) {
+	return ns > 0 && !prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(ns), 0, 0, 0);
+}
+
+#else
+
+bool Affinity::pin_thread(const cpu_list &cpus) {
+	return cpus.empty();
+}
+
+bool Affinity::prefer_node(const void*, size_t, int node) {
+	return node < 0;
+}
+
+bool Affinity::set_timer_slack(long long) {
+	return false;
+}
+
+#endif
+#endif
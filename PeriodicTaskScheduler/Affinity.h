@@ -0,0 +1,129 @@
+#ifndef _AFFINITY_H_
+#define _AFFINITY_H_
+
+#include <stddef.h>
+#include <new>
+#include <string>
+#include <vector>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using cpu_list = std::vector<int>;		/* CPU numbers; empty: any CPU */
+
+/* CPUs of the threads of a scheduler, see `TaskScheduler::set_affinity`; empty: not pinned */
+struct affinity_config {
+	cpu_list dispatcher;				/* scheduler thread */
+	cpu_list workers;					/* task threads and typed task pools */
+	cpu_list storage;					/* aggregate, persist and spill replay threads */
+	cpu_list io;						/* metrics server */
+};
+
+/* hybrid sleep/spin waits of a thread, see `Thread::set_precision`; all 0: plain waits */
+struct precision_config {
+	long long spin_us;					/* sleep until this long before a deadline, then spin */
+	int fifo_priority;					/* SCHED_FIFO priority (1..99) if permitted, 0: none */
+	long long timer_slack_ns;			/* Linux timer slack of the thread (default 50000ns),
+										0: kept */
+};
+
+/**
+	\description CPU pinning, NUMA placement and real-time scheduling of threads (Linux:
+	sched affinity, mbind/set_mempolicy, SCHED_FIFO, timer slack; Windows: thread affinity 
+	masks of processor group 0, NUMA node masks, thread priority). Memory is only
+	ever preferred on a node: where the node has no free pages, or the platform cannot
+	place memory, it is allocated as usual
+*/
+class Affinity {
+public:
+	/**
+		parse "0-3,8,10-11" or "node:1" (CPUs of NUMA node 1)
+
+		@return bool				false if `spec` is malformed or names no CPU
+	*/
+	static bool parse(const char *spec, cpu_list &out);
+	static std::string to_string(const cpu_list &cpus);
+	/**
+		pin the calling thread to `cpus`; if they all belong to one NUMA node, memory first
+		touched by the thread afterwards is preferred on that node
+
+		@return bool				false if refused or not supported; true for empty `cpus`
+	*/
+	static bool pin_thread(const cpu_list &cpus);
+	/**
+		@return int					number of NUMA nodes, 1 without NUMA
+	*/
+	static int node_count();
+	/**
+		@return cpu_list			CPUs of node `node`, empty if unknown
+	*/
+	static cpu_list node_cpus(int node);
+	/**
+		@return int					node holding all of `cpus`, -1 if several or unknown
+	*/
+	static int node_of(const cpu_list &cpus);
+	/**
+		prefer node `node` for the pages of [p, p + bytes), moving pages already touched
+
+		@return bool				false if not supported; true for `node` < 0
+	*/
+	static bool prefer_node(const void *p, size_t bytes, int node);
+	/**
+		whole pages of their own for `bytes`, page aligned: `prefer_node` on them moves no
+		memory of other objects; release with `free_pages`
+
+		@return void*				nullptr if out of memory
+	*/
+	static void *alloc_pages(size_t bytes);
+	static void free_pages(void *p);
+	/**
+		run the calling thread with real-time priority `priority` (SCHED_FIFO; Windows: time
+		critical priority), or with the normal policy for 0
+
+		@return bool				false if not permitted (e.g. without CAP_SYS_NICE)
+	*/
+	static bool set_realtime(int priority);
+	/**
+		timer slack of the calling thread: how late the kernel may end its timed sleeps to
+		batch wakeups (Linux only)
+
+		@return bool				false if not supported
+	*/
+	static bool set_timer_slack(long long ns);
+	/* hint to the CPU that the calling thread is spinning */
+	static void cpu_relax() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+		_mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+};
+
+/**
+	\description standard allocator of arrays on pages of their own (`Affinity::alloc_pages`),
+	for arrays kept on a NUMA node with `Affinity::prefer_node`
+*/
+template <class T>
+class PageAllocator {
+public:
+	using value_type = T;
+	template <class U> struct rebind { using other = PageAllocator<U>; };
+
+	PageAllocator() noexcept {}
+	template <class U> PageAllocator(const PageAllocator<U>&) noexcept {}
+
+	T *allocate(size_t n) {
+		void *p = Affinity::alloc_pages(n * sizeof(T));
+		if (!p) { throw std::bad_alloc(); }
+		return static_cast<T*>(p);
+	}
+	void deallocate(T *p, size_t) noexcept { Affinity::free_pages(p); }
+};
+
+template <class T, class U>
+bool operator==(const PageAllocator<T>&, const PageAllocator<U>&) noexcept { return true; }
+template <class T, class U>
+bool operator!=(const PageAllocator<T>&, const PageAllocator<U>&) noexcept { return false; }
+
+#endif
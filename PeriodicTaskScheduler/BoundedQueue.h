@@ -0,0 +1,170 @@
+#ifndef _BOUNDED_QUEUE_H_
+#define _BOUNDED_QUEUE_H_
+
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+/* what a full queue does with a new item */
+enum overflow_policy {
+	OVERFLOW_BLOCK = 0,						/* producer waits for free space */
+	OVERFLOW_DROP_OLDEST = 1,				/* oldest queued item is dropped */
+	OVERFLOW_DROP_NEWEST = 2,				/* new item is dropped */
+	OVERFLOW_SPILL = 3						/* new item is passed to the spill handler */
+};
+
+/* counters of a pipeline stage/queue */
+struct stage_stats {
+	size_t depth;							/* items queued now */
+	size_t max_depth;						/* high-water mark of `depth` */
+	size_t capacity;
+	unsigned long long pushed;				/* items accepted into queue */
+	unsigned long long popped;
+	unsigned long long dropped;				/* items lost by overflow */
+	unsigned long long spilled;				/* items handed to spill handler */
+};
+
+/**
+	\description fixed-capacity FIFO between two pipeline stages; storage is allocated 
+	once, items are copied in and out. On overflow the configured policy applies; with
+	OVERFLOW_SPILL and no (or a failing) spill handler the new item is dropped
+*/
+template<typename T>
+class BoundedQueue {
+	std::vector<T> buf_;
+	size_t head_{ 0 };						/* index of oldest item */
+	size_t size_{ 0 };
+	overflow_policy policy_;
+	bool closed_{ false };
+	std::function<bool(const T&)> spill_;
+	std::function<void(const T&)> evict_;
+
+	std::mutex mutex_;
+	std::condition_variable cv_not_empty_;
+	std::condition_variable cv_not_full_;
+	stage_stats stats_{};
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue & operator = (const BoundedQueue&) = delete;
+public:
+	BoundedQueue(size_t capacity, overflow_policy policy) : 
+		buf_(capacity ? capacity : 1), policy_(policy) {
+		stats_.capacity = buf_.size();
+	}
+	/**
+		set handler of OVERFLOW_SPILL; called on the producer thread without lock held
+
+		@param spill				returns true if the item was saved
+	*/
+	void set_spill(std::function<bool(const T&)> spill) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		spill_ = spill;
+	}
+	/**
+		set observer of items dropped by OVERFLOW_DROP_OLDEST; called on the producer thread 
+		without lock held
+	*/
+	void set_evict(std::function<void(const T&)> evict) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		evict_ = evict;
+	}
+	/**
+		@return bool				true if item was queued or spilled, false if it was dropped 
+									(or queue is closed)
+	*/
+	bool push(const T &v) {
+		std::function<bool(const T&)> spill;
+		std::function<void(const T&)> evict;
+		T evicted;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			if (policy_ == OVERFLOW_BLOCK) {
+				cv_not_full_.wait(lock, [this] { return closed_ || size_ < buf_.size(); });
+			}
+			if (closed_) {
+				++stats_.dropped;
+				return false;
+			}
+			if (size_ == buf_.size()) {
+				if (policy_ == OVERFLOW_DROP_OLDEST) {
+					if (evict_) {
+						evict = evict_;
+						evicted = buf_[head_];
+					}
+					head_ = (head_ + 1) % buf_.size();
+					--size_;
+					++stats_.dropped;
+				}
+				else if (policy_ == OVERFLOW_SPILL && spill_) {
+					spill = spill_;
+				}
+				else {
+					++stats_.dropped;
+					return false;
+				}
+			}
+			if (!spill) {
+				buf_[(head_ + size_) % buf_.size()] = v;
+				++size_;
+				++stats_.pushed;
+				if (size_ > stats_.max_depth) { stats_.max_depth = size_; }
+			}
+		}
+		if (spill) {
+			bool saved = spill(v);
+			std::lock_guard<std::mutex> lock(mutex_);
+			++(saved ? stats_.spilled : stats_.dropped);
+			return saved;
+		}
+		cv_not_empty_.notify_one();
+		if (evict) { evict(evicted); }
+		return true;
+	}
+	/**
+		move up to `max` items into `out`, waiting up to `wait` for the first one
+
+		@return size_t				number of items appended to `out`; 0 on timeout or when 
+									queue is closed and drained
+	*/
+	template<typename R, typename P>
+	size_t pop_batch(std::vector<T> &out, size_t max, std::chrono::duration<R, P> const &wait) {
+		size_t n = 0;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_not_empty_.wait_for(lock, wait, [this] { return closed_ || size_ > 0; });
+			for (; n < max && size_; ++n) {
+				out.push_back(buf_[head_]);
+				head_ = (head_ + 1) % buf_.size();
+				--size_;
+			}
+			stats_.popped += n;
+		}
+		if (n) { cv_not_full_.notify_all(); }
+		return n;
+	}
+	/**
+		refuse further items and wake up all waiters; queued items can still be popped
+	*/
+	void close() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			closed_ = true;
+		}
+		cv_not_empty_.notify_all();
+		cv_not_full_.notify_all();
+	}
+	bool drained() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return closed_ && !size_;
+	}
+	stage_stats get_stats() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		stage_stats s = stats_;
+		s.depth = size_;
+		return s;
+	}
+};
+
+#endif
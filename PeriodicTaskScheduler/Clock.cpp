@@ -0,0 +1,130 @@
+#include "Clock.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	implementation of \class Clock
+*/
+
+void Clock::sleep_until(time_point t) {
+	mutex m;
+	condition_variable cv;
+	unique_lock<mutex> lock(m);
+	wait_until(lock, cv, t, [] { return false; });
+}
+
+shared_ptr<Clock> Clock::system() {
+	static shared_ptr<Clock> clock = make_shared<SystemClock>();
+	return clock;
+}
+
+unsigned long long SystemClock::unix_ms() {
+	return static_cast<unsigned long long>(
+		duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+/*
+	implementation of \class VirtualClock
+*/
+
+Clock::time_point VirtualClock::now() {
+	lock_guard<mutex> lock(mu_);
+	return now_;
+}
+
+unsigned long long VirtualClock::unix_ms() {
+	lock_guard<mutex> lock(mu_);
+	return unix_start_ms_ + static_cast<unsigned long long>(
+		duration_cast<milliseconds>(now_.time_since_epoch()).count());
+}
+
+bool VirtualClock::wait_until(unique_lock<mutex> &lock, condition_variable &cv, time_point t,
+	const wake_condition &wake) {
+	// the caller's mutex is released while blocked: `notify` never needs it
+	lock.unlock();
+	{
+		unique_lock<mutex> g(mu_);
+		if (!wake() && t > now_) {
+			sleeper s;
+			s.key = &cv;
+			s.pos = deadlines_.emplace(t, &s);
+			by_cv_[&cv] = &s;
+			if (++blocked_ >= attached_) { cv_idle_.notify_all(); }
+			s.cv.wait(g, [&s] { return s.fired; });
+		}
+	}
+	lock.lock();
+	return wake();
+}
+
+void VirtualClock::fire(sleeper *s) {
+	deadlines_.erase(s->pos);
+	by_cv_.erase(s->key);
+	s->fired = true;
+	--blocked_;
+	s->cv.notify_one();
+}
+
+void VirtualClock::notify(condition_variable &cv) {
+	lock_guard<mutex> lock(mu_);
+	auto it = by_cv_.find(&cv);
+	if (it != by_cv_.end()) { fire(it->second); }
+}
+
+void VirtualClock::attach() {
+	lock_guard<mutex> lock(mu_);
+	++attached_;
+}
+
+void VirtualClock::detach() {
+	lock_guard<mutex> lock(mu_);
+	--attached_;
+	if (blocked_ >= attached_) { cv_idle_.notify_all(); }
+}
+
+void VirtualClock::step() {
+	if (deadlines_.begin()->first > now_) { now_ = deadlines_.begin()->first; }
+	++instants_;
+	// everything due now runs before time moves again
+	while (!deadlines_.empty() && deadlines_.begin()->first <= now_) {
+		++wakeups_;
+		fire(deadlines_.begin()->second);
+	}
+}
+
+void VirtualClock::advance_to(time_point t) {
+	unique_lock<mutex> lock(mu_);
+	while (true) {
+		cv_idle_.wait(lock, [this] { return blocked_ >= attached_; });
+		if (deadlines_.empty() || deadlines_.begin()->first > t) {
+			break;
+		}
+		step();
+	}
+	if (t > now_) { now_ = t; }
+}
+
+void VirtualClock::join(thread &t, const wake_condition &done) {
+	{
+		unique_lock<mutex> lock(mu_);
+		while (true) {
+			cv_idle_.wait(lock, [&] { return done() || blocked_ >= attached_; });
+			if (done() || deadlines_.empty() || deadlines_.begin()->first == time_point::max()) {
+				break;
+			}
+			step();
+		}
+	}
+	t.join();
+}
+
+unsigned long long VirtualClock::wakeups() {
+	lock_guard<mutex> lock(mu_);
+	return wakeups_;
+}
+
+unsigned long long VirtualClock::wake_instants() {
+	lock_guard<mutex> lock(mu_);
+	return instants_;
+}
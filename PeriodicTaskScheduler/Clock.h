@@ -0,0 +1,138 @@
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <condition_variable>
+#include <map>
+#include <unordered_map>
+
+/**
+	\description source of time of tasks: current time, timed waits and result timestamps.
+	Every wait whose `wake` condition is changed by another thread must be interrupted
+	through `notify`, so that a virtual clock knows the waiter is runnable again
+*/
+class Clock {
+public:
+	using time_point = std::chrono::steady_clock::time_point;
+	using duration = std::chrono::steady_clock::duration;
+	using wake_condition = std::function<bool()>;
+
+	virtual ~Clock() noexcept {}
+	virtual time_point now() = 0;
+	/* wall clock time of `now()`, in milliseconds since unix epoch */
+	virtual unsigned long long unix_ms() = 0;
+	/**
+		block until `wake()` is true or `t` is reached; `lock` holds the mutex that `cv`
+		is used with, it is held again on return. `wake` may be called with internal locks
+		held and must only read atomics
+
+		@return bool				value of `wake()`
+	*/
+	virtual bool wait_until(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+		time_point t, const wake_condition &wake) = 0;
+	/**
+		wake the waiter on `cv` after its wake condition was changed; a cv is waited on by
+		at most one thread at a time
+	*/
+	virtual void notify(std::condition_variable &cv) = 0;
+	/**
+		a thread whose waits take part in the progress of time starts/stops; only
+		virtual clocks count them
+	*/
+	virtual void attach() {}
+	virtual void detach() {}
+	/**
+		join thread `t` once `done()` (it left the clock); a virtual clock keeps time moving
+		meanwhile, so that work in progress can finish
+	*/
+	virtual void join(std::thread &t, const wake_condition &) { t.join(); }
+	/* time only moves when driven, so it must never be waited for by spinning */
+	virtual bool simulated() { return false; }
+
+	void sleep_until(time_point t);
+	void sleep_for(duration d) { sleep_until(now() + d); }
+
+	/* process-wide `SystemClock` */
+	static std::shared_ptr<Clock> system();
+};
+
+/**
+	\description real time: steady_clock for waits, system_clock for timestamps
+*/
+class SystemClock : public Clock {
+public:
+	virtual time_point now() { return std::chrono::steady_clock::now(); }
+	virtual unsigned long long unix_ms();
+	virtual bool wait_until(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+		time_point t, const wake_condition &wake) {
+		return cv.wait_until(lock, t, wake);
+	}
+	virtual void notify(std::condition_variable &cv) { cv.notify_all(); }
+};
+
+/**
+	\description simulated time for accelerated and reproducible runs: time stands still
+	until the driver calls `advance_to`/`advance_for`, which then jumps from deadline to
+	deadline, each time waiting until every attached thread is blocked in a wait of this
+	clock. Work functions consume simulated time with `sleep_for`; everything else takes
+	none, so that the timeline of executions is exact whatever the load of the host.
+	Commands (add, pause, cancel...) issued by the driver between two `advance_*` calls
+	take effect at the current simulated time
+*/
+class VirtualClock : public Clock {
+	struct sleeper;
+	using deadline_map = std::multimap<time_point, sleeper*>;
+	struct sleeper {
+		deadline_map::iterator pos;			/* in `deadlines_` */
+		std::condition_variable *key;		/* cv of the waiter, see `notify` */
+		std::condition_variable cv;			/* waiter blocks on this one */
+		bool fired = false;
+	};
+	std::mutex mu_;							/* guards everything below */
+	std::condition_variable cv_idle_;		/* all attached threads are blocked */
+	deadline_map deadlines_;				/* blocked waiters by deadline */
+	std::unordered_map<std::condition_variable*, sleeper*> by_cv_;
+	time_point now_;
+	unsigned long long unix_start_ms_;
+	size_t attached_{ 0 };
+	size_t blocked_{ 0 };					/* attached threads waiting, not yet fired */
+	unsigned long long wakeups_{ 0 };
+	unsigned long long instants_{ 0 };
+
+	void fire(sleeper *s);					/* caller holds `mu_` */
+	void step();							/* run the next deadline; caller holds `mu_` */
+public:
+	/**
+		@param unix_start_ms		wall clock time of the start, for result timestamps
+	*/
+	VirtualClock(unsigned long long unix_start_ms = 1500000000000ull) :
+		now_(), unix_start_ms_(unix_start_ms) {}
+
+	virtual time_point now();
+	virtual unsigned long long unix_ms();
+	virtual bool wait_until(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+		time_point t, const wake_condition &wake);
+	virtual void notify(std::condition_variable &cv);
+	virtual void attach();
+	virtual void detach();
+	virtual void join(std::thread &t, const wake_condition &done);
+	virtual bool simulated() { return true; }
+
+	/**
+		let simulated time run up to `t`, or `d` from now; returns once every attached
+		thread is blocked with `now() == t`
+	*/
+	void advance_to(time_point t);
+	void advance_for(duration d) { advance_to(now() + d); }
+	/* waits ended by reaching their deadline so far */
+	unsigned long long wakeups();
+	/* distinct times at which waits ended by reaching their deadline: wakeups of an idle 
+	host, whatever the number of threads woken together */
+	unsigned long long wake_instants();
+};
+
+#endif
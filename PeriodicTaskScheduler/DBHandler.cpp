@@ -1,7 +1,9 @@
 #include "DBHandler.h"
+#include "Logger.h"
 
 #include <ios>
 #include <iostream>
+#include <stdexcept>
 
 using namespace std;
 
@@ -24,20 +26,24 @@ bool SQLiteHandler::db_setup() {
 	try {
 		char *err;
 
-		if (sqlite3_open(db_name_, &db_)) {
-			throw exception("open db failed");
+		if (sqlite3_open(db_name_.c_str(), &db_)) {
+			throw runtime_error("open db failed");
 		}
 
 		const char *cmd_create_tab = "CREATE TABLE IF NOT EXISTS TASK (ID INTEGER PRIMARY KEY, TID INTEGER, NAME STRING, TIME STRING, VALUE DOUBLE, MINVALUE DOUBLE, MAXVALUE DOUBLE, AVGVALUE DOUBLE)";
 
 		if (sqlite3_exec(db_, cmd_create_tab, nullptr, nullptr, &err)) {
-			printf(err);
-			throw exception(err);
+			log_error("create table failed: %s", string(err));
+			throw runtime_error(err);
+		}
+		const char *cmd_insert = "INSERT INTO TASK VALUES(NULL, ?, ?, ?, ?, ?, ?, ?)";
+		if (sqlite3_prepare_v2(db_, cmd_insert, -1, &insert_stmt_, nullptr)) {
+			throw runtime_error(sqlite3_errmsg(db_));
 		}
 		is_open = true;
 	}
-	catch (exception e) {
-		printf(e.what());
+	catch (exception &e) {
+		log_error("%s", string(e.what()));
 		is_open = false;
 	}
 	return is_open;
@@ -64,7 +70,7 @@ bool SQLiteHandler::db_insert(size_t tid, const char *task_name, float value) {
 		char **tab = nullptr, *error = nullptr;
 
 		if (sqlite3_get_table(db_, cmd, &tab, &nrow, &ncol, &error)) {
-			throw exception("query table error");
+			throw runtime_error("query table error");
 		}
 		if (nrow) {
 			//for (int r = 0; r <= nrow; ++r) {
@@ -81,25 +87,85 @@ bool SQLiteHandler::db_insert(size_t tid, const char *task_name, float value) {
 			"INSERT INTO TASK VALUES(NULL, %zd, '%s', '%s', %f, %f, %f, %f)", 
 			tid, task_name, timestamp, val, minv, maxv, avgv);
 		if (sqlite3_exec(db_, cmd, nullptr, nullptr, &error)) {
-			throw exception(error);
+			throw runtime_error(error);
 			sqlite3_free(error);
 		}
-		printf("table updated: tid:%zd, tname:%s, val:%f, minv:%f, maxv:%f, avgv:%f\n", 
-			tid, task_name, val, minv, maxv, avgv);
+		log_debug("table updated: tid:%zd, tname:%s, val:%f, minv:%f, maxv:%f, avgv:%f", 
+			tid, string(task_name), val, minv, maxv, avgv);
 		sqlite3_free_table(tab);
 	}
-	catch (exception e) {
-		printf("%s\n", e.what());
+	catch (exception &e) {
+		log_error("%s", string(e.what()));
 		return false;
 	}
 	return true;
 }
 
+bool SQLiteHandler::db_write(const StoreRecord *recs, size_t n) {
+	if (!is_open) return false;
+	if (!n) return true;
+
+	lock_guard<mutex> lock(mutex_);
+	char *error = nullptr;
+	if (sqlite3_exec(db_, "BEGIN", nullptr, nullptr, &error)) {
+		log_error("begin batch failed: %s", string(error));
+		sqlite3_free(error);
+		return false;
+	}
+	bool status = true;
+	char timestamp[24];
+	for (size_t i = 0; i < n && status; ++i) {
+		const StoreRecord &r = recs[i];
+		sprintf(timestamp, "%llu", r.timestamp);
+		sqlite3_bind_int64(insert_stmt_, 1, static_cast<sqlite3_int64>(r.tid));
+		sqlite3_bind_text(insert_stmt_, 2, r.name ? r.name->c_str() : "", -1, SQLITE_STATIC);
+		sqlite3_bind_text(insert_stmt_, 3, timestamp, -1, SQLITE_TRANSIENT);
+		sqlite3_bind_double(insert_stmt_, 4, r.value);
+		sqlite3_bind_double(insert_stmt_, 5, r.agg.minv);
+		sqlite3_bind_double(insert_stmt_, 6, r.agg.maxv);
+		sqlite3_bind_double(insert_stmt_, 7, r.agg.avgv);
+		status = sqlite3_step(insert_stmt_) == SQLITE_DONE;
+		sqlite3_reset(insert_stmt_);
+	}
+	sqlite3_clear_bindings(insert_stmt_);
+
+	if (!status || sqlite3_exec(db_, "COMMIT", nullptr, nullptr, &error)) {
+		log_error("write batch of %zd failed: %s", n, string(error ? error : sqlite3_errmsg(db_)));
+		sqlite3_free(error);
+		sqlite3_exec(db_, "ROLLBACK", nullptr, nullptr, nullptr);
+		return false;
+	}
+	return true;
+}
+
+bool SQLiteHandler::db_last(size_t tid, TaskAggregate &agg) {
+	if (!is_open) return false;
+
+	lock_guard<mutex> lock(mutex_);
+	const char *cmd = "SELECT MINVALUE, MAXVALUE, AVGVALUE, (SELECT COUNT(*) FROM TASK WHERE TID=?1) "
+		"FROM TASK WHERE TID=?1 ORDER BY TIME DESC, ID DESC LIMIT 1";
+	sqlite3_stmt *stmt = nullptr;
+	if (sqlite3_prepare_v2(db_, cmd, -1, &stmt, nullptr)) {
+		return false;
+	}
+	sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(tid));
+	bool found = sqlite3_step(stmt) == SQLITE_ROW;
+	if (found) {
+		agg.minv = static_cast<float>(sqlite3_column_double(stmt, 0));
+		agg.maxv = static_cast<float>(sqlite3_column_double(stmt, 1));
+		agg.avgv = static_cast<float>(sqlite3_column_double(stmt, 2));
+		agg.count = static_cast<unsigned long long>(sqlite3_column_int64(stmt, 3));
+	}
+	sqlite3_finalize(stmt);
+	return found;
+}
+
 unsigned long SQLiteHandler::get_timestamp() {
 		return static_cast<unsigned long>
 			(std::chrono::duration_cast<std::chrono::milliseconds>
 			(std::chrono::system_clock::now().time_since_epoch()).count());
 }
 SQLiteHandler::~SQLiteHandler() noexcept {
+	if (insert_stmt_) sqlite3_finalize(insert_stmt_);
 	if (is_open) sqlite3_close(db_);
 }
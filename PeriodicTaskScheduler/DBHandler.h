@@ -6,11 +6,75 @@
 #include <algorithm>
 #include <chrono>
 #include <mutex>
+#include <memory>
+#include <string>
 #include "sqlite3.h"
 
-class SQLiteHandler {
+/* running aggregates of the values of a task */
+struct TaskAggregate {
+	unsigned long long count;				/* number of values aggregated */
+	float minv;
+	float maxv;
+	float avgv;
+};
+
+/* one task result ready to be stored, with aggregates up to and including it */
+struct StoreRecord {
+	size_t tid;
+	unsigned long long timestamp;			/* unix time, in milliseconds */
+	float value;
+	TaskAggregate agg;
+	std::shared_ptr<const std::string> name;	/* name/description of the task */
+};
+
+/**
+	\description abstract storage backend shared by all task threads; a backend receives
+	every legal task result through `db_insert` and must be safe to call concurrently
+*/
+class StorageBackend {
+public:
+	virtual ~StorageBackend() noexcept {}
+	/**
+		prepare backend resources (open db/files), which will be kept open
+
+		@return bool				true if backend is ready for inserts
+	*/
+	virtual bool db_setup() = 0;
+	/**
+		store one result of a task
+
+		@param size_t tid			task uid
+		@param task_name			name/description of the task
+		@param float value			result value returned by task work
+		@return bool				true if stored
+	*/
+	virtual bool db_insert(size_t tid, const char* task_name, float value) = 0;
+	/**
+		store a batch of results whose aggregates are already computed; backends should
+		store all records or none of them. Default inserts records one by one
+
+		@param recs/n				records to be stored, in time order per task
+		@return bool				true if batch was stored
+	*/
+	virtual bool db_write(const StoreRecord *recs, size_t n) {
+		bool status = true;
+		for (size_t i = 0; i < n; ++i) {
+			status &= db_insert(recs[i].tid, recs[i].name ? recs[i].name->c_str() : "", recs[i].value);
+		}
+		return status;
+	}
+	/**
+		load the latest aggregates of a task, so that they continue across restarts
+
+		@return bool				false if nothing is stored for the task
+	*/
+	virtual bool db_last(size_t, TaskAggregate &) { return false; }
+};
+
+class SQLiteHandler : public StorageBackend {
 	sqlite3 *db_;
-	const char *db_name_;
+	sqlite3_stmt *insert_stmt_{ nullptr };	/* prepared insert used by `db_write` */
+	std::string db_name_;					/* copied: callers may pass a temporary */
 	bool is_open{ false };
 
 	typedef unsigned long ulong;
@@ -20,9 +84,12 @@ class SQLiteHandler {
 public:
 	SQLiteHandler(const char *db_name):db_name_(db_name) {}
 	~SQLiteHandler() noexcept;
-	bool db_setup();
+	virtual bool db_setup();
 
-	bool db_insert(size_t tid, const char* task_name, float value);
+	virtual bool db_insert(size_t tid, const char* task_name, float value);
+	/* batch insert in one transaction, without querying previous records */
+	virtual bool db_write(const StoreRecord *recs, size_t n);
+	virtual bool db_last(size_t tid, TaskAggregate &agg);
 	//int test();
 };
 
@@ -0,0 +1,88 @@
+#include "Histogram.h"
+
+/*
+	implementation of \class BasicHistogram
+*/
+
+template<unsigned SubBits>
+void BasicHistogram<SubBits>::reset() {
+	for (auto &c : counts_) { c.store(0, std::memory_order_relaxed); }
+	count_.store(0);
+	sum_.store(0);
+	max_.store(0);
+}
+
+template<unsigned SubBits>
+histogram_snapshot BasicHistogram<SubBits>::snapshot() const {
+	histogram_snapshot s;
+	s.counts.assign(LatencyHistogram::BUCKETS, 0);
+	s.count = 0;
+	// count taken from buckets, so that percentiles are consistent with them; a bucket
+	// goes to the full resolution bucket with the same upper bound
+	for (size_t i = 0; i < BUCKETS; ++i) {
+		unsigned long long n = counts_[i].load(std::memory_order_relaxed);
+		s.counts[LatencyHistogram::bucket_of(bucket_value(i))] += n;
+		s.count += n;
+	}
+	s.sum = sum_.load(std::memory_order_relaxed);
+	s.max = max_.load(std::memory_order_relaxed);
+	return s;
+}
+
+histogram_snapshot histogram_snapshot::since(const histogram_snapshot &earlier) const {
+	histogram_snapshot h{ count - earlier.count, sum - earlier.sum, 0, counts };
+	for (size_t i = 0; i < h.counts.size() && i < earlier.counts.size(); ++i) {
+		h.counts[i] -= earlier.counts[i];
+		if (h.counts[i]) { h.max = LatencyHistogram::bucket_value(i); }
+	}
+	return h;
+}
+
+histogram_snapshot histogram_snapshot::merge(const histogram_snapshot &other) const {
+	bool longer = counts.size() >= other.counts.size();
+	histogram_snapshot h{ count + other.count, sum + other.sum, max > other.max ? max : other.max, 
+		longer ? counts : other.counts };
+	const std::vector<unsigned long long> &rest = longer ? other.counts : counts;
+	for (size_t i = 0; i < rest.size(); ++i) { h.counts[i] += rest[i]; }
+	return h;
+}
+
+unsigned long long histogram_snapshot::percentile(double p) const {
+	if (!count) return 0;
+	unsigned long long rank = static_cast<unsigned long long>(p / 100.0 * count + 0.5);
+	if (rank < 1) rank = 1;
+	if (rank > count) rank = count;
+	unsigned long long seen = 0;
+	for (size_t i = 0; i < counts.size(); ++i) {
+		seen += counts[i];
+		if (seen >= rank) {
+			unsigned long long v = LatencyHistogram::bucket_value(i);
+			return v < max ? v : max;
+		}
+	}
+	return max;
+}
+
+template<unsigned SubBits>
+void BasicHistogram<SubBits>::quantiles(const double *p, unsigned long long *out, size_t n) const {
+	unsigned long long total = 0;
+	for (size_t i = 0; i < BUCKETS; ++i) { total += counts_[i].load(std::memory_order_relaxed); }
+	unsigned long long m = max_.load(std::memory_order_relaxed), seen = 0;
+	size_t b = 0;
+	for (size_t k = 0; k < n; ++k) {
+		if (!total) { out[k] = 0; continue; }
+		unsigned long long rank = static_cast<unsigned long long>(p[k] / 100.0 * total + 0.5);
+		if (rank < 1) rank = 1;
+		if (rank > total) rank = total;
+		// percentiles ascend, so the bucket walk continues where the last one stopped
+		while (b < BUCKETS && seen + counts_[b].load(std::memory_order_relaxed) < rank) {
+			seen += counts_[b].load(std::memory_order_relaxed);
+			++b;
+		}
+		unsigned long long v = b < BUCKETS ? bucket_value(b) : m;
+		out[k] = v < m ? v : m;
+	}
+}
+
+template class BasicHistogram<5>;
+template class BasicHistogram<1>;
@@ -0,0 +1,155 @@
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/* copy of a histogram at one point of time */
+struct histogram_snapshot {
+	unsigned long long count;
+	unsigned long long sum;					/* sum of all values, in microseconds */
+	unsigned long long max;
+	std::vector<unsigned long long> counts;	/* per bucket, see `LatencyHistogram::bucket_value` */
+	/**
+		value below which `p` (0..100) percent of recorded values fall; upper bound of its 
+		bucket, i.e. within ~3% of the exact value (~50% if taken from a `CoarseHistogram`)
+
+		@return unsigned long long	value in microseconds, 0 if empty
+	*/
+	unsigned long long percentile(double p) const;
+	double mean() const { return count ? static_cast<double>(sum) / count : 0; }
+	/**
+		values recorded after `earlier` was taken from the same histogram; `max` is the
+		upper bound of the highest non-empty bucket
+	*/
+	histogram_snapshot since(const histogram_snapshot &earlier) const;
+	/**
+		values of both histograms, e.g. of the same histogram of two schedulers
+	*/
+	histogram_snapshot merge(const histogram_snapshot &other) const;
+};
+
+/**
+	\description lock-free log-linear (HDR style) histogram of durations in microseconds:
+	every power of two is split into 2^SubBits linear buckets, so that each value is kept 
+	with 2^-SubBits precision from 1us up to ~71 minutes (larger values land in the last 
+	bucket). `record` is a few relaxed atomic increments, safe from any number of threads.
+	Snapshots always use the buckets of `LatencyHistogram`, so that histograms of either
+	resolution can be merged and compared
+*/
+template<unsigned SubBits>
+class BasicHistogram {
+public:
+	enum {
+		SUB_BITS = SubBits,
+		SUB_COUNT = 1 << SUB_BITS,
+		MAX_EXP = 32,												/* values < 2^32 us */
+		BUCKETS = (MAX_EXP - SUB_BITS + 1) * SUB_COUNT
+	};
+	BasicHistogram() { reset(); }
+
+	void record(unsigned long long us) {
+		counts_[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+		count_.fetch_add(1, std::memory_order_relaxed);
+		sum_.fetch_add(us, std::memory_order_relaxed);
+		unsigned long long m = max_.load(std::memory_order_relaxed);
+		while (us > m && !max_.compare_exchange_weak(m, us, std::memory_order_relaxed));
+	}
+	void reset();
+	histogram_snapshot snapshot() const;
+	/**
+		percentiles `p[0..n)` (0..100, ascending) computed in place, without allocation
+
+		@param out					receives one value per percentile, in microseconds
+	*/
+	void quantiles(const double *p, unsigned long long *out, size_t n) const;
+	unsigned long long count() const { return count_.load(std::memory_order_relaxed); }
+	unsigned long long sum() const { return sum_.load(std::memory_order_relaxed); }
+
+	static size_t bucket_of(unsigned long long v) {
+		if (v < SUB_COUNT) return static_cast<size_t>(v);
+		int e = 63;
+		while (!(v >> e)) --e;										/* e >= SUB_BITS */
+		if (e >= MAX_EXP) return BUCKETS - 1;
+		return static_cast<size_t>((e - SUB_BITS + 1) * SUB_COUNT + ((v >> (e - SUB_BITS)) - SUB_COUNT));
+	}
+	/* highest value kept in bucket `i` */
+	static unsigned long long bucket_value(size_t i) {
+		if (i < SUB_COUNT) return i;
+		int e = static_cast<int>(i / SUB_COUNT) + SUB_BITS - 1;
+		unsigned long long base = (static_cast<unsigned long long>(i % SUB_COUNT) + SUB_COUNT) << (e - SUB_BITS);
+		return base + (1ull << (e - SUB_BITS)) - 1;
+	}
+private:
+	std::atomic<unsigned long long> counts_[BUCKETS];
+	std::atomic<unsigned long long> count_;
+	std::atomic<unsigned long long> sum_;
+	std::atomic<unsigned long long> max_;
+
+	BasicHistogram(const BasicHistogram&) = delete;
+	BasicHistogram & operator = (const BasicHistogram&) = delete;
+};
+
+typedef BasicHistogram<5> LatencyHistogram;	/* 896 buckets, ~3% precision, ~7KB */
+typedef BasicHistogram<1> CoarseHistogram;	/* 64 buckets, ~50% precision, ~0.5KB */
+
+/* snapshot of the timing histograms of a task, or of all tasks */
+struct timing_snapshot {
+	histogram_snapshot lateness;			/* actual start - intended start of an execution */
+	histogram_snapshot work;				/* duration of work function */
+	histogram_snapshot persist;				/* duration of the storage batch holding a result */
+	histogram_snapshot values;				/* result values, in 1/1000 of value unit */
+};
+
+/**
+	\description timing histograms, of resolution `H`
+*/
+template<typename H>
+class BasicTiming {
+public:
+	H lateness;
+	H work;
+	H persist;
+	H values;								/* sketch of result values, fixed point 1/1000 */
+
+	timing_snapshot snapshot() const {
+		timing_snapshot s;
+		s.lateness = lateness.snapshot();
+		s.work = work.snapshot();
+		s.persist = persist.snapshot();
+		s.values = values.snapshot();
+		return s;
+	}
+};
+
+/* histograms of all tasks of a scheduler, full resolution */
+typedef BasicTiming<LatencyHistogram> SchedulerTiming;
+
+/**
+	\description timing histograms of a task, coarse to keep tasks small; every value is
+	also recorded into `parent` (the scheduler-wide histograms) if given
+*/
+class TaskTiming : public BasicTiming<CoarseHistogram> {
+	std::shared_ptr<SchedulerTiming> parent_;
+public:
+	TaskTiming(std::shared_ptr<SchedulerTiming> parent = nullptr) : parent_(parent) {}
+
+	void record_lateness(unsigned long long us) {
+		lateness.record(us);
+		if (parent_) parent_->lateness.record(us);
+	}
+	void record_work(unsigned long long us) {
+		work.record(us);
+		if (parent_) parent_->work.record(us);
+	}
+	void record_persist(unsigned long long us) {
+		persist.record(us);
+	}
+	void record_value(float v) {
+		values.record(v > 0 ? static_cast<unsigned long long>(v * 1000.0f + 0.5f) : 0);
+	}
+};
+
+#endif
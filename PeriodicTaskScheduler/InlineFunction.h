@@ -0,0 +1,122 @@
+#ifndef _INLINE_FUNCTION_H_
+#define _INLINE_FUNCTION_H_
+
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+template <class Signature, size_t InlineSize = 64> class InlineFunction;
+
+/**
+	\description move-only callable wrapper: a callable of up to `InlineSize` bytes (and of
+	fundamental alignment, nothrow move constructible) is stored inside the wrapper, larger
+	ones are moved to the heap. Calls go through one function pointer, with no allocation
+	and no copy of the callable; an empty wrapper must not be called
+*/
+template <class R, class... Args, size_t InlineSize>
+class InlineFunction<R(Args...), InlineSize> {
+	/* per callable type operations */
+	struct ops {
+		R(*call)(void *self, Args&&... args);
+		void(*move)(void *to, void *from);		/* move-construct into `to`, destroy `from` */
+		void(*destroy)(void *self);
+		bool heap;
+	};
+
+	template <class F> struct fits_inline : std::integral_constant<bool,
+		sizeof(F) <= InlineSize && alignof(F) <= alignof(max_align_t) &&
+		std::is_nothrow_move_constructible<F>::value> {};
+
+	template <class F> struct inline_ops {
+		static R call(void *self, Args&&... args) {
+			return (*static_cast<F*>(self))(std::forward<Args>(args)...);
+		}
+		static void move(void *to, void *from) {
+			new (to) F(std::move(*static_cast<F*>(from)));
+			static_cast<F*>(from)->~F();
+		}
+		static void destroy(void *self) { static_cast<F*>(self)->~F(); }
+		static const ops *get() {
+			static const ops o{ &call, &move, &destroy, false };
+			return &o;
+		}
+	};
+
+	/* the buffer holds a `F*` */
+	template <class F> struct heap_ops {
+		static R call(void *self, Args&&... args) {
+			return (**static_cast<F**>(self))(std::forward<Args>(args)...);
+		}
+		static void move(void *to, void *from) { *static_cast<F**>(to) = *static_cast<F**>(from); }
+		static void destroy(void *self) { delete *static_cast<F**>(self); }
+		static const ops *get() {
+			static const ops o{ &call, &move, &destroy, true };
+			return &o;
+		}
+	};
+
+	/* null function pointers and empty std::functions make an empty wrapper */
+	template <class F> static bool is_null(const F&) { return false; }
+	template <class T> static bool is_null(T *p) { return !p; }
+	template <class S> static bool is_null(const std::function<S> &f) { return !f; }
+
+	template <class F> void init(F &&f, std::true_type) {
+		using T = typename std::decay<F>::type;
+		new (buf_) T(std::forward<F>(f));
+		ops_ = inline_ops<T>::get();
+	}
+	template <class F> void init(F &&f, std::false_type) {
+		using T = typename std::decay<F>::type;
+		*reinterpret_cast<T**>(buf_) = new T(std::forward<F>(f));
+		ops_ = heap_ops<T>::get();
+	}
+
+	alignas(max_align_t) unsigned char buf_[InlineSize < sizeof(void*) ? sizeof(void*) : InlineSize];
+	const ops *ops_ = nullptr;
+public:
+	static const size_t inline_size = InlineSize;
+
+	InlineFunction() noexcept {}
+	InlineFunction(std::nullptr_t) noexcept {}
+	template <class F, class T = typename std::decay<F>::type,
+		class = typename std::enable_if<!std::is_same<T, InlineFunction>::value>::type>
+	InlineFunction(F &&f) {
+		if (!is_null(f)) { init(std::forward<F>(f), fits_inline<T>()); }
+	}
+	InlineFunction(InlineFunction &&other) noexcept {
+		if (other.ops_) {
+			other.ops_->move(buf_, other.buf_);
+			ops_ = other.ops_;
+			other.ops_ = nullptr;
+		}
+	}
+	InlineFunction &operator=(InlineFunction &&other) noexcept {
+		if (this != &other) {
+			reset();
+			if (other.ops_) {
+				other.ops_->move(buf_, other.buf_);
+				ops_ = other.ops_;
+				other.ops_ = nullptr;
+			}
+		}
+		return *this;
+	}
+	InlineFunction(const InlineFunction&) = delete;
+	InlineFunction &operator=(const InlineFunction&) = delete;
+	~InlineFunction() noexcept { reset(); }
+
+	void reset() noexcept {
+		if (ops_) {
+			ops_->destroy(buf_);
+			ops_ = nullptr;
+		}
+	}
+	explicit operator bool() const noexcept { return ops_ != nullptr; }
+	/* true if the callable did not fit the buffer */
+	bool on_heap() const noexcept { return ops_ && ops_->heap; }
+	R operator()(Args... args) { return ops_->call(buf_, std::forward<Args>(args)...); }
+};
+
+#endif
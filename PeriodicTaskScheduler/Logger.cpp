@@ -0,0 +1,199 @@
+#include <time.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <chrono>
+#include <system_error>
+#include "Logger.h"
+
+#pragma warning(disable: 4996 )
+
+namespace {
+	const char *LEVEL_NAMES[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR" };
+
+	/* keeps the buffer of a thread alive until it is flushed after the thread exits */
+	struct LocalBuffer {
+		std::shared_ptr<LogBuffer> buffer;
+		~LocalBuffer() { if (buffer) { buffer->retired.store(true); } }
+	};
+	thread_local LocalBuffer local;
+
+	void append(std::string &out, const char *spec, ...) {
+		char buf[256];
+		va_list args;
+		va_start(args, spec);
+		int n = vsnprintf(buf, sizeof(buf), spec, args);
+		va_end(args);
+		if (n > 0) { out.append(buf, std::min<size_t>(n, sizeof(buf) - 1)); }
+	}
+}
+
+/*
+	implementation of \class Logger
+*/
+
+Logger &Logger::get() {
+	// never destroyed, since tasks log from static destructors; flushed at exit instead
+	static Logger *logger = [] {
+		Logger *l = new Logger();
+		atexit([] { get().stop(); });
+		return l;
+	}();
+	return *logger;
+}
+
+Logger::~Logger() {
+	stop();
+}
+
+LogBuffer *Logger::local_buffer() {
+	if (!local.buffer) {
+		try {
+			std::call_once(started_, [this] { flusher_ = std::thread(&Logger::run, this); });
+		}
+		catch (const std::system_error &) {
+			// out of threads: records wait in the buffer, start is retried by the next new buffer
+		}
+		auto b = std::make_shared<LogBuffer>();
+		b->thread = next_thread_.fetch_add(1);
+		std::lock_guard<std::mutex> lock(mu_buffers_);
+		buffers_.push_back(b);
+		local.buffer = b;
+	}
+	return local.buffer.get();
+}
+
+LogRecord *Logger::claim(LogBuffer *&b) {
+	b = local_buffer();
+	uint64_t head = b->head.load(std::memory_order_relaxed);
+	if (head - b->tail.load(std::memory_order_acquire) >= LogBuffer::SLOTS) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	LogRecord *r = &b->slots[head % LogBuffer::SLOTS];
+	r->time_us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count());
+	r->thread = b->thread;
+	return r;
+}
+
+void Logger::commit(LogBuffer *b) {
+	b->head.store(b->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void Logger::set_output(FILE *f) {
+	std::lock_guard<std::mutex> lock(mu_buffers_);
+	out_ = f ? f : stdout;
+}
+
+void Logger::run() {
+	while (!stop_.load()) {
+		flush();
+		std::this_thread::sleep_for(std::chrono::milliseconds(flush_ms_.load()));
+	}
+	flush();
+}
+
+void Logger::stop() {
+	stop_.store(true);
+	if (flusher_.joinable()) { flusher_.join(); }
+	flush();
+}
+
+size_t Logger::flush() {
+	std::lock_guard<std::mutex> lock(mu_buffers_);
+	// retired buffers are removed once drained
+	flushing_.clear();
+	for (size_t i = 0; i < buffers_.size(); ) {
+		auto &b = buffers_[i];
+		bool retired = b->retired.load();
+		flushing_.push_back(b);
+		if (retired && b->head.load() == b->tail.load()) {
+			buffers_[i] = buffers_.back();
+			buffers_.pop_back();
+		}
+		else { ++i; }
+	}
+	size_t n = 0;
+	line_.clear();
+	for (auto &b : flushing_) {
+		uint64_t head = b->head.load(std::memory_order_acquire);
+		for (uint64_t t = b->tail.load(std::memory_order_relaxed); t < head; ++t) {
+			format(b->slots[t % LogBuffer::SLOTS]);
+			b->tail.store(t + 1, std::memory_order_release);
+			++n;
+			if (line_.size() > (64 << 10)) {
+				fwrite(line_.data(), 1, line_.size(), out_);
+				line_.clear();
+			}
+		}
+	}
+	if (!line_.empty()) {
+		fwrite(line_.data(), 1, line_.size(), out_);
+		fflush(out_);
+	}
+	flushing_.clear();
+	written_.fetch_add(n);
+	return n;
+}
+
+void Logger::format(const LogRecord &r) {
+	time_t sec = static_cast<time_t>(r.time_us / 1000000);
+	if (sec != stamp_sec_) {
+		strftime(stamp_, sizeof(stamp_), "%Y-%m-%d %H:%M:%S", localtime(&sec));
+		stamp_sec_ = sec;
+	}
+	append(line_, "%s.%06u %-5s [%u] ", stamp_, static_cast<unsigned>(r.time_us % 1000000),
+		LEVEL_NAMES[r.level < LOG_OFF ? static_cast<int>(r.level) : static_cast<int>(LOG_ERROR)], r.thread);
+
+	// printf conversions, re-typed by captured argument
+	char spec[32];
+	size_t arg = 0;
+	for (const char *p = r.fmt; *p; ++p) {
+		if (*p != '%') { line_ += *p; continue; }
+		if (p[1] == '%') { line_ += '%'; ++p; continue; }
+		const char *begin = p++;
+		size_t len = 1;
+		spec[0] = '%';
+		while (*p && strchr("-+ #0123456789.", *p)) {
+			if (len < sizeof(spec) - 4) { spec[len++] = *p; }
+			++p;
+		}
+		while (*p && strchr("hlLqjzt", *p)) ++p;
+		if (!*p) { line_.append(begin); break; }
+		char conv = *p;
+		if (arg >= r.nargs) { line_.append(begin, p + 1); continue; }
+		bool integer = strchr("diouxXc", conv) != nullptr;
+		bool real = strchr("fFeEgGaA", conv) != nullptr;
+		// finish `spec` with length modifier `mods` and conversion `c`
+		auto finish = [&](const char *mods, char c) {
+			while (*mods) { spec[len++] = *mods++; }
+			spec[len++] = c;
+			spec[len] = 0;
+			return spec;
+		};
+		auto &a = r.args[arg];
+		switch (r.types[arg++]) {
+		case LOG_ARG_INT:
+			if (real) { append(line_, finish("", conv), static_cast<double>(a.i)); }
+			else if (conv == 'c') { append(line_, finish("", 'c'), static_cast<int>(a.i)); }
+			else { append(line_, finish("ll", integer ? conv : 'd'), a.i); }
+			break;
+		case LOG_ARG_UINT:
+			if (real) { append(line_, finish("", conv), static_cast<double>(a.u)); }
+			else if (conv == 'c') { append(line_, finish("", 'c'), static_cast<int>(a.u)); }
+			else { append(line_, finish("ll", integer && conv != 'd' && conv != 'i' ? conv : 'u'), a.u); }
+			break;
+		case LOG_ARG_DOUBLE:
+			if (integer) { append(line_, finish("ll", 'd'), static_cast<long long>(a.d)); }
+			else { append(line_, finish("", real ? conv : 'g'), a.d); }
+			break;
+		case LOG_ARG_STR:
+			append(line_, finish("", 's'), r.text + a.u);
+			break;
+		case LOG_ARG_PTR:
+			append(line_, "%p", a.p);
+			break;
+		}
+	}
+	line_ += '\n';
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <type_traits>
+
+enum log_level {
+	LOG_TRACE,
+	LOG_DEBUG,
+	LOG_INFO,
+	LOG_WARN,
+	LOG_ERROR,
+	LOG_OFF								/* as threshold: log nothing */
+};
+
+enum log_arg_type : uint8_t {
+	LOG_ARG_INT,
+	LOG_ARG_UINT,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_STR,						/* text copied into `LogRecord::text` */
+	LOG_ARG_PTR
+};
+
+/**
+	\description one log call as captured on the calling thread: the format string and
+	the raw arguments, formatted later by the flusher. `fmt` must outlive the flush (a 
+	literal); text arguments are copied into `text`
+*/
+struct LogRecord {
+	enum { MAX_ARGS = 6, TEXT_BYTES = 112 };	/* 192 bytes */
+	uint64_t time_us;					/* system clock, since epoch */
+	const char *fmt;
+	uint32_t thread;					/* logger assigned thread number */
+	uint8_t level;
+	uint8_t nargs;
+	uint8_t types[MAX_ARGS];
+	union {
+		long long i;
+		unsigned long long u;
+		double d;
+		const void *p;
+	} args[MAX_ARGS];
+	char text[TEXT_BYTES];				/* copied strings, nul separated, truncated if longer */
+};
+
+/**
+	\description single-producer/single-consumer ring of records owned by one thread;
+	the owner never waits: a full ring drops the record and counts it
+*/
+struct LogBuffer {
+	enum { SLOTS = 128 };				/* 24KB per logging thread */
+	LogRecord slots[SLOTS];
+	std::atomic<uint64_t> head{ 0 };	/* next slot to write, owner only */
+	std::atomic<uint64_t> tail{ 0 };	/* next slot to flush, flusher only */
+	std::atomic<bool> retired{ false };	/* owner thread exited */
+	uint32_t thread = 0;
+};
+
+/**
+	\description structured asynchronous logger: every thread writes records into its own
+	lock-free `LogBuffer`, a background thread formats them and writes them to the output
+	every `flush_ms`, so a log call on a hot path costs a level check and a copy of its
+	arguments, and no lock or i/o. Records of one thread keep their order; records of
+	different threads are not interleaved by time. `level()` defaults to LOG_INFO
+*/
+class Logger {
+	std::atomic<int> level_{ LOG_INFO };
+	std::atomic<unsigned long long> dropped_{ 0 };
+	std::atomic<unsigned long long> written_{ 0 };
+	std::atomic<uint32_t> next_thread_{ 0 };
+	std::atomic<bool> stop_{ false };
+	std::atomic<unsigned> flush_ms_{ 10 };
+
+	std::mutex mu_buffers_;				/* guards `buffers_` and `out_` */
+	std::vector<std::shared_ptr<LogBuffer>> buffers_;
+	std::vector<std::shared_ptr<LogBuffer>> flushing_;	/* copy of `buffers_` used by `flush` */
+	std::string line_;					/* formatting buffer of the flusher */
+	long long stamp_sec_ = -1;			/* second of `stamp_` */
+	char stamp_[32];					/* formatted date and time, reused within a second */
+	FILE *out_;
+	std::once_flag started_;
+	std::thread flusher_;
+
+	Logger() : out_(stdout) {}
+	LogBuffer *local_buffer();
+	void run();
+	void format(const LogRecord &r);
+
+	/* argument capture, one overload per `log_arg_type` */
+	template<typename T>
+	typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+	capture(LogRecord &r, size_t &, T v) {
+		r.types[r.nargs] = LOG_ARG_INT; r.args[r.nargs++].i = v;
+	}
+	template<typename T>
+	typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+	capture(LogRecord &r, size_t &, T v) {
+		r.types[r.nargs] = LOG_ARG_UINT; r.args[r.nargs++].u = v;
+	}
+	template<typename T>
+	typename std::enable_if<std::is_floating_point<T>::value>::type
+	capture(LogRecord &r, size_t &, T v) {
+		r.types[r.nargs] = LOG_ARG_DOUBLE; r.args[r.nargs++].d = v;
+	}
+	template<typename T>
+	typename std::enable_if<std::is_enum<T>::value>::type
+	capture(LogRecord &r, size_t &, T v) {
+		r.types[r.nargs] = LOG_ARG_INT; r.args[r.nargs++].i = static_cast<long long>(v);
+	}
+	void capture_text(LogRecord &r, size_t &used, const char *s, size_t len) {
+		size_t at = std::min<size_t>(used, LogRecord::TEXT_BYTES - 1);
+		size_t n = std::min<size_t>(len, LogRecord::TEXT_BYTES - 1 - at);
+		memcpy(r.text + at, s, n);
+		r.text[at + n] = 0;
+		used = at + n + 1;
+		r.types[r.nargs] = LOG_ARG_STR; r.args[r.nargs++].u = at;
+	}
+	void capture(LogRecord &r, size_t &used, const char *s) {
+		if (!s) { s = "(null)"; }
+		capture_text(r, used, s, strlen(s));
+	}
+	void capture(LogRecord &r, size_t &used, const std::string &s) {
+		capture_text(r, used, s.data(), s.size());
+	}
+	void capture(LogRecord &r, size_t &, const void *p) {
+		r.types[r.nargs] = LOG_ARG_PTR; r.args[r.nargs++].p = p;
+	}
+	void capture_all(LogRecord &, size_t &) {}
+	template<typename T, typename... Args>
+	void capture_all(LogRecord &r, size_t &used, const T &v, const Args&... args) {
+		if (r.nargs < LogRecord::MAX_ARGS) { capture(r, used, v); }
+		capture_all(r, used, args...);
+	}
+	LogRecord *claim(LogBuffer *&b);
+	void commit(LogBuffer *b);
+public:
+	~Logger();
+	static Logger &get();
+
+	bool enabled(log_level l) const { return l >= level_.load(std::memory_order_relaxed); }
+	log_level level() const { return static_cast<log_level>(level_.load()); }
+	void set_level(log_level l) { level_.store(l); }
+	/**
+		write formatted records to `f` (not closed by the logger); default stdout
+	*/
+	void set_output(FILE *f);
+	void set_flush_interval(unsigned ms) { flush_ms_.store(ms ? ms : 1); }
+	/**
+		queue a record; `fmt` takes printf conversions, whose length modifiers are
+		ignored (each argument is printed by its captured type)
+
+		@param fmt					static format string
+		@param args					integers, floating points, enums, pointers,
+									`const char*`, `std::string` (copied, up to 
+									`LogRecord::TEXT_BYTES` in total)
+	*/
+	template<typename... Args>
+	void write(log_level l, const char *fmt, const Args&... args) {
+		LogBuffer *b = nullptr;
+		LogRecord *r = claim(b);
+		if (!r) return;
+		r->level = static_cast<uint8_t>(l);
+		r->fmt = fmt;
+		r->nargs = 0;
+		size_t used = 0;
+		capture_all(*r, used, args...);
+		commit(b);
+	}
+	/**
+		format and write all queued records of all threads; called by the flusher thread,
+		and on destruction
+
+		@return size_t				records written
+	*/
+	size_t flush();
+	/**
+		stop flusher thread after a final flush; later records are flushed by `flush` only
+	*/
+	void stop();
+
+	unsigned long long dropped() const { return dropped_.load(); }
+	unsigned long long written() const { return written_.load(); }
+};
+
+template<typename... Args>
+inline void log_write(log_level l, const char *fmt, const Args&... args) {
+	Logger &logger = Logger::get();
+	if (logger.enabled(l)) { logger.write(l, fmt, args...); }
+}
+template<typename... Args>
+inline void log_trace(const char *fmt, const Args&... args) { log_write(LOG_TRACE, fmt, args...); }
+template<typename... Args>
+inline void log_debug(const char *fmt, const Args&... args) { log_write(LOG_DEBUG, fmt, args...); }
+template<typename... Args>
+inline void log_info(const char *fmt, const Args&... args) { log_write(LOG_INFO, fmt, args...); }
+template<typename... Args>
+inline void log_warn(const char *fmt, const Args&... args) { log_write(LOG_WARN, fmt, args...); }
+template<typename... Args>
+inline void log_error(const char *fmt, const Args&... args) { log_write(LOG_ERROR, fmt, args...); }
+
+#endif
\ No newline at end of file
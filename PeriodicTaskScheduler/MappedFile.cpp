@@ -0,0 +1,177 @@
+#include "MappedFile.h"
+
+#include <errno.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+MappedFile::~MappedFile() noexcept {
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open_read(const char *path) {
+	close();
+	HANDLE h = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE) return false;
+	hfile_ = h;
+
+	LARGE_INTEGER sz;
+	if (!GetFileSizeEx(h, &sz) || sz.QuadPart == 0) { close(); return false; }
+	return map(static_cast<size_t>(sz.QuadPart), false);
+}
+
+bool MappedFile::open_write(const char *path, size_t size) {
+	close();
+	HANDLE h = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE) return false;
+	hfile_ = h;
+	return map(size, true);
+}
+
+bool MappedFile::map(size_t size, bool writable) {
+	LARGE_INTEGER sz; sz.QuadPart = static_cast<LONGLONG>(size);
+	hmap_ = CreateFileMappingA(hfile_, NULL, writable ? PAGE_READWRITE : PAGE_READONLY,
+		sz.HighPart, sz.LowPart, NULL);
+	if (hmap_ == NULL) { close(); return false; }
+
+	data_ = static_cast<uint8_t*>(MapViewOfFile(hmap_,
+		writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size));
+	if (data_ == nullptr) { close(); return false; }
+	size_ = size;
+	writable_ = writable;
+	return true;
+}
+
+bool MappedFile::open_shm(const char *name, size_t size, bool create) {
+	close();
+	// named mapping backed by the paging file; lives as long as one handle is open
+	if (create) {
+		LARGE_INTEGER sz; sz.QuadPart = static_cast<LONGLONG>(size);
+		hmap_ = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 
+			sz.HighPart, sz.LowPart, name);
+	}
+	else {
+		hmap_ = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	}
+	if (hmap_ == NULL) { close(); return false; }
+
+	data_ = static_cast<uint8_t*>(MapViewOfFile(hmap_, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 
+		create ? size : 0));
+	if (data_ == nullptr) { close(); return false; }
+	if (!create) {
+		MEMORY_BASIC_INFORMATION info;
+		VirtualQuery(data_, &info, sizeof(info));
+		size = info.RegionSize;
+	}
+	size_ = size;
+	writable_ = create;
+	return true;
+}
+
+void MappedFile::unlink_shm(const char *) {}
+
+void MappedFile::sync() {
+	if (data_ && writable_ && hfile_) { FlushViewOfFile(data_, size_); }
+}
+
+void MappedFile::close() {
+	if (data_) { UnmapViewOfFile(data_); data_ = nullptr; }
+	if (hmap_) { CloseHandle(hmap_); hmap_ = nullptr; }
+	if (hfile_) { CloseHandle(hfile_); hfile_ = nullptr; }
+	size_ = 0;
+	writable_ = false;
+}
+
+bool MappedFile::make_dir(const char *path) {
+	return _mkdir(path) == 0 || errno == EEXIST;
+}
+
+#else
+
+bool MappedFile::open_read(const char *path) {
+	close();
+	fd_ = ::open(path, O_RDONLY);
+	if (fd_ < 0) return false;
+
+	struct stat st;
+	if (fstat(fd_, &st) || st.st_size == 0) { close(); return false; }
+	return map(static_cast<size_t>(st.st_size), false);
+}
+
+bool MappedFile::open_write(const char *path, size_t size) {
+	close();
+	fd_ = ::open(path, O_RDWR | O_CREAT, 0644);
+	if (fd_ < 0) return false;
+
+	struct stat st;
+	if (fstat(fd_, &st)) { close(); return false; }
+	if (static_cast<size_t>(st.st_size) < size && ftruncate(fd_, static_cast<off_t>(size))) {
+		close(); return false;
+	}
+	return map(size, true);
+}
+
+bool MappedFile::map(size_t size, bool writable) {
+	void *p = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd_, 0);
+	if (p == MAP_FAILED) { close(); return false; }
+	data_ = static_cast<uint8_t*>(p);
+	size_ = size;
+	writable_ = writable;
+	// sealed segments are scanned front to back
+	if (!writable) { madvise(p, size, MADV_SEQUENTIAL); }
+	return true;
+}
+
+bool MappedFile::open_shm(const char *name, size_t size, bool create) {
+	close();
+	fd_ = shm_open(name, create ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (fd_ < 0) return false;
+
+	struct stat st;
+	if (fstat(fd_, &st)) { close(); return false; }
+	if (!create) { 
+		size = static_cast<size_t>(st.st_size); 
+		if (!size) { close(); return false; }
+	}
+	else if (static_cast<size_t>(st.st_size) != size && ftruncate(fd_, static_cast<off_t>(size))) {
+		close(); return false;
+	}
+	void *p = mmap(nullptr, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd_, 0);
+	if (p == MAP_FAILED) { close(); return false; }
+	data_ = static_cast<uint8_t*>(p);
+	size_ = size;
+	writable_ = create;
+	return true;
+}
+
+void MappedFile::unlink_shm(const char *name) {
+	shm_unlink(name);
+}
+
+void MappedFile::sync() {
+	if (data_ && writable_) { msync(data_, size_, MS_ASYNC); }
+}
+
+void MappedFile::close() {
+	if (data_) { munmap(data_, size_); data_ = nullptr; }
+	if (fd_ >= 0) { ::close(fd_); fd_ = -1; }
+	size_ = 0;
+	writable_ = false;
+}
+
+bool MappedFile::make_dir(const char *path) {
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+#endif
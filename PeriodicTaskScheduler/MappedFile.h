@@ -0,0 +1,78 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+	\description thin wrapper of a memory-mapped file (Win32 file mapping / POSIX mmap);
+	a mapping is either read-only over an existing file, or read-write over a file
+	created/extended to a fixed size
+*/
+class MappedFile {
+	uint8_t *data_{ nullptr };
+	size_t size_{ 0 };
+	bool writable_{ false };
+#ifdef _WIN32
+	void *hfile_{ nullptr };			/* HANDLE of file */
+	void *hmap_{ nullptr };				/* HANDLE of file mapping */
+#else
+	int fd_{ -1 };
+#endif
+	bool map(size_t size, bool writable);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile & operator = (const MappedFile&) = delete;
+public:
+	MappedFile() {}
+	~MappedFile() noexcept;
+	/**
+		map an existing file read-only
+
+		@param path					file path
+		@return bool				true if mapped
+	*/
+	bool open_read(const char *path);
+	/**
+		open (or create) file, extend it to `size` bytes if needed and map it read-write
+
+		@param path					file path
+		@param size_t size			size of the mapping in bytes
+		@return bool				true if mapped
+	*/
+	bool open_write(const char *path, size_t size);
+	/**
+		map a named shared memory object (POSIX shm_open / Win32 named file mapping);
+		the creator maps it read-write, others may attach read-only
+
+		@param name					object name, e.g. "/pts_results"
+		@param size_t size			size of the object; ignored if `create` is false
+		@param bool create			create the object (read-write) or attach to it (read-only)
+		@return bool				true if mapped
+	*/
+	bool open_shm(const char *name, size_t size, bool create);
+	/**
+		remove a named shared memory object; existing mappings stay valid
+	*/
+	static void unlink_shm(const char *name);
+	/**
+		flush dirty pages of a writable mapping to disk
+	*/
+	void sync();
+	void close();
+
+	bool is_open() const { return data_ != nullptr; }
+	uint8_t* data() { return data_; }
+	const uint8_t* data() const { return data_; }
+	size_t size() const { return size_; }
+
+	/**
+		create directory `path` if it does not exist yet
+
+		@return bool				true if directory exists afterwards
+	*/
+	static bool make_dir(const char *path);
+};
+
+#endif
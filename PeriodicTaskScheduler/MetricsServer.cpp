@@ -0,0 +1,283 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+#include <stdarg.h>
+#include <string.h>
+#include <algorithm>
+#include "MetricsServer.h"
+#include "Logger.h"
+using namespace PeriodicTaskScheduler;
+
+#pragma warning(disable: 4996 )
+
+namespace {
+#ifdef _WIN32
+	typedef int socklen_t;
+	inline void close_socket(intptr_t fd) { closesocket(static_cast<SOCKET>(fd)); }
+#else
+	inline void close_socket(intptr_t fd) { ::close(static_cast<int>(fd)); }
+#endif
+
+	/* printf-append to `out`; no allocation once `out` has grown to its working size */
+	void appendf(string &out, const char *fmt, ...) {
+		char buf[512];
+		va_list args;
+		va_start(args, fmt);
+		int n = vsnprintf(buf, sizeof(buf), fmt, args);
+		va_end(args);
+		if (n > 0) { out.append(buf, min(static_cast<size_t>(n), sizeof(buf) - 1)); }
+	}
+
+	const double LE_SECONDS[] = { 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 60 };
+	const double QUANTILES[] = { 50, 90, 99 };
+
+	void render_histogram(string &out, const char *name, const char *help, const histogram_snapshot &h) {
+		appendf(out, "# TYPE %s histogram\n# HELP %s %s\n", name, name, help);
+		unsigned long long cum = 0;
+		size_t b = 0;
+		for (double le : LE_SECONDS) {
+			unsigned long long le_us = static_cast<unsigned long long>(le * 1e6);
+			for (; b < h.counts.size() && LatencyHistogram::bucket_value(b) <= le_us; ++b) { cum += h.counts[b]; }
+			appendf(out, "%s_bucket{le=\"%g\"} %llu\n", name, le, cum);
+		}
+		appendf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, h.count);
+		appendf(out, "%s_sum %.6f\n%s_count %llu\n", name, h.sum / 1e6, name, h.count);
+	}
+
+	void render_stage(string &out, const char *stage, const stage_stats &s) {
+		appendf(out, "pts_queue_depth{stage=\"%s\"} %zu\n", stage, s.depth);
+	}
+}
+
+/*
+	implementation of \class MetricsServer
+*/
+
+MetricsServer::~MetricsServer() noexcept {
+	stop();
+	if (listen_fd_ >= 0) { close_socket(listen_fd_); }
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+bool MetricsServer::open() {
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData)) {
+		return false;
+	}
+#endif
+	intptr_t fd = static_cast<intptr_t>(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+	if (fd < 0) {
+		log_error("metrics socket failed");
+		return false;
+	}
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port_);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) || listen(fd, 16)) {
+		log_error("metrics listen on port %d failed", port_);
+		close_socket(fd);
+		return false;
+	}
+	listen_fd_ = fd;
+	start();
+	return true;
+}
+
+void MetricsServer::run() {
+	while (!if_stop()) {
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(listen_fd_, &fds);
+		timeval tv{ 0, 200000 };		/* check `stop_` every 200ms */
+		if (select(static_cast<int>(listen_fd_ + 1), &fds, nullptr, nullptr, &tv) <= 0) {
+			continue;
+		}
+		intptr_t fd = static_cast<intptr_t>(accept(listen_fd_, nullptr, nullptr));
+		if (fd < 0) continue;
+		serve(fd);
+		close_socket(fd);
+	}
+}
+
+void MetricsServer::serve(intptr_t fd) {
+#ifdef _WIN32
+	DWORD timeout = 1000;
+#else
+	timeval timeout{ 1, 0 };
+#endif
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+
+	char req[4096];
+	size_t len = 0;
+	while (len < sizeof(req) - 1) {
+		int n = recv(fd, req + len, static_cast<int>(sizeof(req) - 1 - len), 0);
+		if (n <= 0) break;
+		len += n;
+		req[len] = 0;
+		if (strstr(req, "\r\n\r\n")) break;
+	}
+	req[len] = 0;
+
+	response_.clear();
+	if (!strncmp(req, "GET /metrics ", 13) || !strncmp(req, "GET /metrics?", 13)) {
+		render();
+		appendf(response_, "HTTP/1.1 200 OK\r\n"
+			"Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+			"Content-Length: %zu\r\nConnection: close\r\n\r\n", body_.size());
+		response_.append(body_);
+	}
+	else {
+		response_ = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+	}
+	for (size_t sent = 0; sent < response_.size(); ) {
+		int n = send(fd, response_.data() + sent, static_cast<int>(response_.size() - sent), 0);
+		if (n <= 0) break;
+		sent += n;
+	}
+}
+
+const string &MetricsServer::task_labels(const task_row &t) {
+	string &l = labels_[t.tid];
+	if (l.empty()) {
+		appendf(l, "tid=\"%zu\",name=\"", t.tid);
+		for (char c : *t.name) {
+			if (c == '\\' || c == '"') { l += '\\'; l += c; }
+			else if (c == '\n') { l += "\\n"; }
+			else { l += c; }
+		}
+		l += '"';
+	}
+	return l;
+}
+
+void MetricsServer::render() {
+	body_.clear();
+	scheduler_->copy_tasks(tasks_);
+	scheduler_->copy_pooled_tasks(pooled_);
+	scheduler_->copy_task_values(values_);
+	rows_.clear();
+	for (auto &t : tasks_) {
+		rows_.push_back(task_row{ t->get_task_id(), t->is_paused(), t->get_timing().get(), &t->get_name() });
+	}
+	for (auto &t : pooled_) {
+		rows_.push_back(task_row{ t.tid, t.paused, t.timing.get(), t.name.get() });
+	}
+	sort(rows_.begin(), rows_.end(), [](const task_row &a, const task_row &b) { 
+		return a.tid < b.tid; 
+	});
+	sort(values_.begin(), values_.end(), [](const task_values &a, const task_values &b) { 
+		return a.tid < b.tid; 
+	});
+	// labels of canceled tasks
+	if (labels_.size() > rows_.size() * 2 + 64) {
+		labels_.clear();
+	}
+
+	// tasks by state
+	size_t paused = 0;
+	for (auto &t : rows_) { paused += t.paused ? 1 : 0; }
+	appendf(body_, "# TYPE pts_tasks gauge\n# HELP pts_tasks Registered tasks by state.\n");
+	appendf(body_, "pts_tasks{state=\"running\"} %zu\npts_tasks{state=\"paused\"} %zu\n", 
+		rows_.size() - paused, paused);
+
+	// scheduler-wide histograms
+	timing_snapshot timing = scheduler_->get_timing();
+	render_histogram(body_, "pts_dispatch_lateness_seconds", 
+		"Actual minus intended start of task executions.", timing.lateness);
+	render_histogram(body_, "pts_work_duration_seconds", "Duration of task work functions.", timing.work);
+	render_histogram(body_, "pts_persist_duration_seconds", "Duration of storage batches.", timing.persist);
+
+	// pipeline
+	pipeline_stats ps = scheduler_->get_pipeline_stats();
+	appendf(body_, "# TYPE pts_queue_depth gauge\n# HELP pts_queue_depth Records queued per pipeline stage.\n");
+	render_stage(body_, "result", ps.result);
+	render_stage(body_, "persist", ps.persist);
+	appendf(body_, "# TYPE pts_queue_dropped counter\n# HELP pts_queue_dropped Records dropped on overflow.\n");
+	appendf(body_, "pts_queue_dropped_total{stage=\"result\"} %llu\n", ps.result.dropped);
+	appendf(body_, "pts_queue_dropped_total{stage=\"persist\"} %llu\n", ps.persist.dropped);
+	appendf(body_, "# TYPE pts_queue_spilled counter\n# HELP pts_queue_spilled Records spilled to disk.\n");
+	appendf(body_, "pts_queue_spilled_total %llu\n", ps.spill.spilled);
+	appendf(body_, "# TYPE pts_db_batches counter\n# HELP pts_db_batches Storage batches written.\n");
+	appendf(body_, "pts_db_batches_total %llu\n", ps.batches);
+	appendf(body_, "# TYPE pts_db_records counter\n# HELP pts_db_records Records by storage outcome.\n");
+	appendf(body_, "pts_db_records_total{outcome=\"stored\"} %llu\n", ps.stored);
+	appendf(body_, "pts_db_records_total{outcome=\"failed\"} %llu\n", ps.store_failed);
+	appendf(body_, "# TYPE pts_db_batch_size gauge\n# HELP pts_db_batch_size Records in latest batch.\n");
+	appendf(body_, "pts_db_batch_size %zu\n", ps.last_batch);
+
+	// subscriptions
+	scheduler_->copy_subscription_stats(subs_);
+	sort(subs_.begin(), subs_.end(), [](const pair<size_t, subscription_stats> &a, 
+		const pair<size_t, subscription_stats> &b) { return a.first < b.first; });
+	appendf(body_, "# TYPE pts_subscription_delivered counter\n"
+		"# HELP pts_subscription_delivered Results passed to a subscription callback.\n");
+	for (auto &s : subs_) {
+		appendf(body_, "pts_subscription_delivered_total{sid=\"%zu\"} %llu\n", s.first, s.second.delivered);
+	}
+	appendf(body_, "# TYPE pts_subscription_dropped counter\n"
+		"# HELP pts_subscription_dropped Results dropped since a subscriber fell behind.\n");
+	for (auto &s : subs_) {
+		appendf(body_, "pts_subscription_dropped_total{sid=\"%zu\"} %llu\n", s.first, s.second.dropped);
+	}
+
+	// per task values, one family at a time
+	const char *families[] = { "pts_task_value", "pts_task_value_min", "pts_task_value_max", "pts_task_value_avg" };
+	for (int f = 0; f < 4; ++f) {
+		appendf(body_, "# TYPE %s gauge\n", families[f]);
+		size_t v = 0;
+		for (auto &t : rows_) {
+			while (v < values_.size() && values_[v].tid < t.tid) ++v;
+			if (v == values_.size() || values_[v].tid != t.tid) continue;
+			const task_values &tv = values_[v];
+			float x = f == 0 ? tv.last : f == 1 ? tv.agg.minv : f == 2 ? tv.agg.maxv : tv.agg.avgv;
+			appendf(body_, "%s{%s} %g\n", families[f], task_labels(t).c_str(), x);
+		}
+	}
+	// per task quantiles
+	unsigned long long q[3];
+	appendf(body_, "# TYPE pts_task_value_sketch summary\n"
+		"# HELP pts_task_value_sketch Quantiles of task result values.\n");
+	for (auto &t : rows_) {
+		const CoarseHistogram &h = t.timing->values;
+		const string &l = task_labels(t);
+		h.quantiles(QUANTILES, q, 3);
+		for (int i = 0; i < 3; ++i) {
+			appendf(body_, "pts_task_value_sketch{%s,quantile=\"%g\"} %g\n", l.c_str(), QUANTILES[i] / 100, q[i] / 1e3);
+		}
+		appendf(body_, "pts_task_value_sketch_sum{%s} %g\npts_task_value_sketch_count{%s} %llu\n", 
+			l.c_str(), h.sum() / 1e3, l.c_str(), h.count());
+	}
+	appendf(body_, "# TYPE pts_task_lateness_seconds summary\n"
+		"# HELP pts_task_lateness_seconds Dispatch lateness per task.\n");
+	for (auto &t : rows_) {
+		const CoarseHistogram &h = t.timing->lateness;
+		const string &l = task_labels(t);
+		h.quantiles(QUANTILES, q, 3);
+		for (int i = 0; i < 3; ++i) {
+			appendf(body_, "pts_task_lateness_seconds{%s,quantile=\"%g\"} %g\n", l.c_str(), QUANTILES[i] / 100, q[i] / 1e6);
+		}
+		appendf(body_, "pts_task_lateness_seconds_sum{%s} %g\npts_task_lateness_seconds_count{%s} %llu\n", 
+			l.c_str(), h.sum() / 1e6, l.c_str(), h.count());
+	}
+	body_ += "# EOF\n";
+	rows_.clear();								/* drop task references, keep capacity */
+	tasks_.clear();
+	pooled_.clear();
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef _METRICS_SERVER_H_
+#define _METRICS_SERVER_H_
+
+#include "PeriodicTaskScheduler.h"
+
+namespace PeriodicTaskScheduler {
+	/**
+		\description minimal HTTP listener on 127.0.0.1:`port` serving the metrics of a
+		scheduler in OpenMetrics text format on `GET /metrics`:
+			tasks by state, lateness/work/persist histograms, pipeline queue depths and drops,
+			db batch counters, delivered/dropped results per subscription, and per task 
+			(thread and typed tasks): last/min/max/avg value, value quantiles and lateness 
+			quantiles
+		one request is served at a time on the server's own thread. The response is rendered
+		into buffers kept across scrapes, per task label sets are rendered once per task and 
+		typed tasks are copied with a pointer to their name, so a scrape of many tasks does 
+		not allocate per series. Listing typed tasks locks each pool (`copy_pooled_tasks`)
+	*/
+	class MetricsServer : public Thread {
+		/* a thread or typed task, as listed in a scrape */
+		struct task_row {
+			size_t tid;
+			bool paused;
+			const TaskTiming *timing;
+			const string *name;
+		};
+
+		TaskScheduler *scheduler_;
+		unsigned short port_;
+		intptr_t listen_fd_{ -1 };				/* listening socket */
+
+		/* buffers reused by every scrape */
+		string body_;
+		string response_;
+		vector<task_container_ptr> tasks_;
+		vector<pooled_task> pooled_;
+		vector<task_row> rows_;					/* `tasks_` and `pooled_` by tid */
+		vector<task_values> values_;
+		vector<pair<size_t, subscription_stats>> subs_;
+		unordered_map<size_t, string> labels_;	/* tid -> `tid="..",name=".."` */
+
+		void render();
+		const string &task_labels(const task_row &t);
+		void serve(intptr_t fd);
+
+		using super = Thread;
+	public:
+		MetricsServer(TaskScheduler *scheduler, unsigned short port) : 
+			scheduler_(scheduler), port_(port) {}
+		~MetricsServer() noexcept;
+		/**
+			bind and listen, then start serving thread
+
+			@return bool				false if port cannot be bound
+		*/
+		bool open();
+		virtual void run();
+		/**
+			render metrics as served on `/metrics`
+		*/
+		const string &scrape() { render(); return body_; }
+	};
+}
+
+#endif
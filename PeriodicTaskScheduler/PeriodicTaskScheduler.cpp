@@ -1,11 +1,36 @@
 
 #include "PeriodicTaskScheduler.h"
+#include "ResultDispatcher.h"
+#include "MetricsServer.h"
+#include "Logger.h"
+#include "Tracer.h"
 using namespace PeriodicTaskScheduler;
 
+/*
+	phase of the `r`-th task of period `p` under PHASE_SPREAD: van der Corput sequence 
+	(bit-reversed counter), 0, 1/2, 1/4, 3/4, 1/8, ... of the period, so the gaps stay within
+	2x of even for any number of tasks
+*/
+static Clock::duration spread_phase(Clock::duration::rep p, uint32_t r) {
+	r = ((r >> 1) & 0x55555555u) | ((r & 0x55555555u) << 1);
+	r = ((r >> 2) & 0x33333333u) | ((r & 0x33333333u) << 2);
+	r = ((r >> 4) & 0x0F0F0F0Fu) | ((r & 0x0F0F0F0Fu) << 4);
+	r = ((r >> 8) & 0x00FF00FFu) | ((r & 0x00FF00FFu) << 8);
+	r = (r >> 16) | (r << 16);
+	return Clock::duration(static_cast<Clock::duration::rep>(p * (r / 4294967296.0)));
+}
+
+/* period in the log, in microseconds */
+static long long period_us(Clock::duration period) {
+	return static_cast<long long>(duration_cast<microseconds>(period).count());
+}
+
 /*
 	implementation of \class Thread
 */
-Thread::Thread() : thread_(), stop_() {}
+Thread::Thread() : Thread(Clock::system()) {}
+Thread::Thread(clock_ptr clock) : thread_(), stop_(), pause_(), clock_(clock), attached_(), 
+	precision_changed_(), spin_ns_() {}
 Thread::~Thread() noexcept {
 	stop();
 }
@@ -13,12 +38,33 @@ Thread::~Thread() noexcept {
 void Thread::start() {
 	set_stop(false);
 	set_pause(false);
-	thread_ = thread(&Thread::run, this);
+	try {
+		thread_ = thread([this](cpu_list cpus) {
+			if (!Affinity::pin_thread(cpus)) {
+				log_error("pin thread to cpus %s failed", Affinity::to_string(cpus));
+			}
+			run(); 
+			release_clock(); 
+		}, cpus_);
+	}
+	catch (...) {
+		release_clock();	/* never runs */
+		throw;
+	}
 }
 
 void Thread::stop() {
 	set_stop(true);
-	if (thread_.joinable()) { thread_.join(); }
+	if (thread_.joinable()) { clock_->join(thread_, [this] { return !attached_; }); }
+	release_clock();
+}
+
+void Thread::attach_clock() {
+	if (!attached_.exchange(true)) { clock_->attach(); }
+}
+
+void Thread::release_clock() {
+	if (attached_.exchange(false)) { clock_->detach(); }
 }
 
 void Thread::pause() { set_pause(true);  }
@@ -37,30 +83,85 @@ bool Thread::if_pause() { return pause_; }
 
 void Thread::guard_pause() {
 	unique_lock<mutex> lock(mutex_);
-	cv_wait_.wait(lock, [&] {return !if_pause();});
+	clock_->wait_until(lock, cv_wait_, Clock::time_point::max(), 
+		[&] {return !if_pause() || if_stop();});
 }
 
 void Thread::set_stop(bool v) {
 	stop_.store(v);
-	if (v) { cv_wait_.notify_all(); }
+	if (v) { clock_->notify(cv_wait_); }
 }
 
 void Thread::set_pause(bool v) {
 	pause_.store(v);
-	if (v) { cv_wait_.notify_all(); }
+	clock_->notify(cv_wait_);	/* pause: leave `wait_for`, resume: leave `guard_pause` */
 }
 
 template<typename R, typename P>
 void Thread::wait_for(duration<R, P> const & s) {
+	wait_until(clock_->now() + duration_cast<Clock::duration>(seconds(s)));
+}
+
+void Thread::wait_until(Clock::time_point t) {
+	auto spin = prepare_wait();
+	auto wake = [&] {return if_stop() || if_pause();};
 	unique_lock<mutex> lock(mutex_);
-	cv_wait_.wait_for(lock, seconds(s), [&] {return if_stop() || if_pause();});
+	if (clock_->wait_until(lock, cv_wait_, t - spin, wake) || spin == Clock::duration::zero()) {
+		return;
+	}
+	lock.unlock();
+	spin_until(t, wake);
+}
+
+void Thread::set_precision(const precision_config &cfg) {
+	lock_guard<mutex> lock(mutex_);
+	precision_ = cfg;
+	spin_ns_ = cfg.spin_us > 0 ? cfg.spin_us * 1000 : 0;
+	precision_changed_ = true;
+}
+
+Clock::duration Thread::prepare_wait() {
+	if (precision_changed_.exchange(false)) {
+		precision_config cfg;
+		{
+			lock_guard<mutex> lock(mutex_);
+			cfg = precision_;
+		}
+		// leave the policy alone unless precision mode asks for SCHED_FIFO or had set it, 
+		// so a thread the caller made real-time itself stays so
+		if (cfg.fifo_priority != fifo_priority_ && (cfg.fifo_priority > 0 || fifo_priority_ > 0)) {
+			if (Affinity::set_realtime(cfg.fifo_priority)) {
+				fifo_priority_ = cfg.fifo_priority > 0 ? cfg.fifo_priority : 0;
+			}
+			else {
+				log_warn("set real-time priority %d refused", cfg.fifo_priority);
+			}
+		}
+		if (cfg.timer_slack_ns && !Affinity::set_timer_slack(cfg.timer_slack_ns)) {
+			log_warn("set timer slack %lldns refused", cfg.timer_slack_ns);
+		}
+	}
+	if (clock_->simulated()) {
+		return Clock::duration::zero();
+	}
+	return duration_cast<Clock::duration>(nanoseconds(spin_ns_.load()));
+}
+
+bool Thread::spin_until(Clock::time_point t, const Clock::wake_condition &wake) {
+	while (clock_->now() < t) {
+		if (wake()) {
+			return true;
+		}
+		Affinity::cpu_relax();
+	}
+	return wake();
 }
 
 /*
 	implementation of \class Task
 */
 
-task_work_ptr Task::get_work() {
+const task_work &Task::get_work() {
 	return work_;
 }
 
@@ -68,124 +169,712 @@ size_t Task::get_task_id() {
 	return tid_;
 }
 
-size_t Task::get_period() {
-	return period_;
-}
-
 void Task::run() {
+	auto clock = get_clock();
+	rephased_ = false;
+	auto due = phase_deadline(clock->now());	/* intended start of the next execution */
+	auto deadline = wakeup(due);				/* same, coalesced within the slack */
+	Tracer::get().name_thread("task " + to_string(tid_) + " " + tname_);
+	wait_until(deadline);
 	while (!if_stop()) { 
-		while (if_pause());
-		printf("working...task id:%zd, thread id:%ud, period:%zd \n", tid_, this_thread::get_id(), period_);
+		if (if_pause()) {
+			guard_pause();
+			due = phase_deadline(clock->now());	/* lateness does not count time paused */
+			deadline = wakeup(due);
+			wait_until(deadline);
+			continue;						/* stopped while paused */
+		}
+		log_debug("working...task id:%zd, period:%lldus", tid_, period_us(get_period()));
 		
-		auto start = steady_clock::now();
-		float elapsed = work_(); // in million seconds
-		// updata db if result is leagal
+		auto start = clock->now();
+		auto lateness = start > deadline ? 
+			static_cast<unsigned long long>(duration_cast<microseconds>(start - deadline).count()) : 0;
+		timing_->record_lateness(lateness);
+		trace_instant(TRACE_DISPATCH, tid_, static_cast<uint32_t>(min(lateness, 0xffffffffULL)));
+		float elapsed;
+		{
+			TraceScope span(TRACE_WORK, tid_);
+			elapsed = work_(); // in million seconds
+		}
+		auto work_us = static_cast<unsigned long long>(
+			duration_cast<microseconds>(clock->now() - start).count());
+		timing_->record_work(work_us);
+		capture_->record_work(tid_, work_us);
+		if (elapsed >= .0) { timing_->record_value(elapsed); }
+		ResultRecord rec{ tid_, clock->unix_ms(), elapsed, RESULT_OK };
+		// queue result for db if it is leagal; never waits for db unless OVERFLOW_BLOCK
 		if (elapsed >= .0) {
-			db_->db_insert(tid_, tname_.c_str(), elapsed);
+			if (!pipeline_->submit(rec)) { rec.status = RESULT_STORE_FAILED; }
 		}
-		auto end = steady_clock::now();
-		auto wait_time = seconds(period_) - duration_cast<seconds>(end - start);
-		if (end - start > seconds::zero()) {
-			wait_for(wait_time);
+		else {
+			rec.status = RESULT_WORK_FAILED;
 		}
+		sinks_->publish(rec);
+		// stay on the schedule of `due` instead of drifting with `start`
+		auto period = get_period();
+		due = next_due(due, start, period);
+		if (rephased_.exchange(false)) {
+			due = phase_deadline(max(clock->now(), due - period / 2));
+		}
+		deadline = wakeup(due);
+		wait_until(deadline);
 	}
 }
 
 void Task::start() {
-	printf("start task %zd\n", tid_);
+	log_info("start task %zd", tid_);
 	super::start();
 }
 
 void Task::stop() {
 	super::stop();	
-	printf("stop task %zd\n", tid_); /* before working function printing*/
+	log_info("stop task %zd", tid_); /* before working function printing*/
 }
 
 void Task::pause() {
 	super::pause();
-	printf("pause task %zd\n", tid_);
+	trace_instant(TRACE_PAUSE, tid_);
+	log_info("pause task %zd", tid_);
 }
 
 void Task::resume() {
 	super::resume();
-	printf("resume task %zd\n", tid_);
+	trace_instant(TRACE_RESUME, tid_);
+	log_info("resume task %zd", tid_);
 }
 
-void Task::update(size_t new_period) {
-	printf("update task %zd period: [%zd]->[%zd]\n", tid_, period_, new_period);
-	period_ = new_period;
+void Task::update(Clock::duration new_period) {
+	log_info("update task %zd period: [%lldus]->[%lldus]", tid_, period_us(get_period()), 
+		period_us(new_period));
+	period_ = new_period.count();
 }
 
 Task::~Task() noexcept{
 	super::stop();
-	printf("destroy task %zd\n", tid_);
+	log_info("destroy task %zd", tid_);
+}
+
+/*
+	implementation of \class TaskPool
+*/
+
+uint64_t TaskPool::begin_execution(uint32_t slot, Clock::time_point start) {
+	auto deadline = table_.deadline(slot);
+	auto lateness = start > deadline ? 
+		static_cast<unsigned long long>(duration_cast<microseconds>(start - deadline).count()) : 0;
+	const task_slot_cold &c = table_.cold(slot);
+	c.timing->record_lateness(lateness);
+	trace_instant(TRACE_DISPATCH, c.tid, static_cast<uint32_t>(min(lateness, 0xffffffffULL)));
+	return Tracer::on() ? Tracer::get().now_ns() : 0;
+}
+
+void TaskPool::end_execution(uint32_t slot, Clock::time_point start, float elapsed, 
+	uint64_t trace_begin) {
+	auto clock = get_clock();
+	const task_slot_cold &c = table_.cold(slot);
+	if (trace_begin && Tracer::on()) {
+		Tracer::get().record(TRACE_WORK, c.tid, 0, trace_begin, Tracer::get().now_ns());
+	}
+	auto work_us = static_cast<unsigned long long>(
+		duration_cast<microseconds>(clock->now() - start).count());
+	c.timing->record_work(work_us);
+	capture_->record_work(c.tid, work_us);
+	ResultRecord rec{ c.tid, clock->unix_ms(), elapsed, RESULT_OK };
+	if (elapsed >= .0) {
+		c.timing->record_value(elapsed);
+		if (!pipeline_->submit(rec)) { rec.status = RESULT_STORE_FAILED; }
+	}
+	else {
+		rec.status = RESULT_WORK_FAILED;
+	}
+	sinks_->publish(rec);
+	schedule(slot, next_due(c.due, start, table_.period(slot)));
+}
+
+void TaskPool::start_deadlines(Clock::time_point now) {
+	for (uint32_t s = 0; s < table_.slots(); ++s) {
+		if (table_.state(s) == SLOT_ACTIVE) { schedule(s, phase_deadline(s, now)); }
+	}
+}
+
+void TaskPool::wait_changed(unique_lock<mutex> &lock, Clock::time_point t) {
+	changed_.value = false;
+	auto spin = prepare_wait();
+	auto wake = [this] { return if_stop() || changed_.value; };
+	if (get_clock()->wait_until(lock, cv_, t - spin, wake) || spin == Clock::duration::zero()) {
+		return;
+	}
+	lock.unlock();							/* commands go on while spinning */
+	spin_until(t, wake);
+	lock.lock();
+}
+
+void TaskPool::notify_changed() {
+	changed_.value = true;
+	get_clock()->notify(cv_);
+}
+
+void TaskPool::start() {
+	log_info("start task pool");
+	super::start();
+}
+
+void TaskPool::stop() {
+	set_stop(true);						/* before waking the pool, which checks it */
+	get_clock()->notify(cv_);
+	super::stop();
+}
+
+bool TaskPool::holds(uint32_t slot, size_t tid) {
+	return slot < table_.slots() && table_.state(slot) != SLOT_FREE && table_.cold(slot).tid == tid;
+}
+
+bool TaskPool::update_task(uint32_t slot, size_t tid, Clock::duration new_period) {
+	lock_guard<mutex> lock(mu_);
+	if (!holds(slot, tid)) {
+		return false;
+	}
+	log_info("update task %zd period: [%lldus]->[%lldus]", tid, period_us(table_.period(slot)), 
+		period_us(new_period));
+	table_.set_period(slot, new_period);
+	/* runs now (or at its phase), as a thread task resumed by the update */
+	schedule(slot, phase_deadline(slot, get_clock()->now()));
+	notify_changed();
+	return true;
+}
+
+bool TaskPool::pause_task(uint32_t slot, size_t tid) {
+	lock_guard<mutex> lock(mu_);
+	if (!holds(slot, tid)) {
+		return false;
+	}
+	table_.set_state(slot, SLOT_PAUSED);
+	trace_instant(TRACE_PAUSE, tid);
+	log_info("pause task %zd", tid);
+	return true;
+}
+
+bool TaskPool::resume_task(uint32_t slot, size_t tid) {
+	lock_guard<mutex> lock(mu_);
+	if (!holds(slot, tid)) {
+		return false;
+	}
+	if (table_.state(slot) == SLOT_PAUSED) {
+		table_.set_state(slot, SLOT_ACTIVE);
+		/* lateness does not count time paused */
+		schedule(slot, phase_deadline(slot, get_clock()->now()));
+		notify_changed();
+	}
+	trace_instant(TRACE_RESUME, tid);
+	log_info("resume task %zd", tid);
+	return true;
+}
+
+bool TaskPool::set_phase(uint32_t slot, size_t tid, Clock::duration phase) {
+	lock_guard<mutex> lock(mu_);
+	if (!holds(slot, tid)) {
+		return false;
+	}
+	table_.set_phase(slot, phase);
+	if (table_.state(slot) == SLOT_ACTIVE) {
+		auto half = table_.period(slot) / 2;
+		schedule(slot, phase_deadline(slot, max(get_clock()->now(), table_.cold(slot).due - half)));
+		notify_changed();
+	}
+	return true;
+}
+
+bool TaskPool::set_slack(uint32_t slot, size_t tid, const task_slack &slack) {
+	lock_guard<mutex> lock(mu_);
+	if (!holds(slot, tid)) {
+		return false;
+	}
+	table_.set_slack(slot, slack);
+	if (table_.state(slot) == SLOT_ACTIVE) {
+		schedule(slot, table_.cold(slot).due);
+		notify_changed();
+	}
+	return true;
+}
+
+Clock::duration TaskPool::get_period(uint32_t slot, size_t tid) {
+	lock_guard<mutex> lock(mu_);
+	return holds(slot, tid) ? table_.period(slot) : Clock::duration::zero();
+}
+
+bool TaskPool::cancel_task(uint32_t slot, size_t tid) {
+	lock_guard<mutex> lock(mu_);
+	if (!holds(slot, tid)) {
+		return false;
+	}
+	erase_work(slot);
+	table_.erase(slot);
+	log_info("stop task %zd", tid);
+	return true;
+}
+
+void TaskPool::set_cpus(const cpu_list &cpus) {
+	super::set_cpus(cpus);
+	lock_guard<mutex> lock(mu_);
+	table_.set_node(Affinity::node_of(cpus));
+}
+
+void TaskPool::copy_tasks(vector<pooled_task> &out) {
+	lock_guard<mutex> lock(mu_);
+	for (uint32_t s = 0; s < table_.slots(); ++s) {
+		if (table_.state(s) == SLOT_FREE) continue;
+		const task_slot_cold &c = table_.cold(s);
+		out.push_back(pooled_task{ c.tid, table_.period(s), table_.deadline(s), 
+			table_.state(s) == SLOT_PAUSED, c.timing, c.name });
+	}
 }
 /*
 	implementation of \class TaskScheduler
 */
 
-bool TaskScheduler::setup_context() {
+TaskScheduler::TaskScheduler(size_t tid_offset, size_t tid_stride) : 
+	dispatcher_(make_shared<ResultDispatcher>()), tid_offset_(tid_offset), 
+	tid_stride_(tid_stride ? tid_stride : 1) {}
+
+TaskScheduler::~TaskScheduler() {
+	stop();
+	dispatcher_->stop();
+}
+
+bool TaskScheduler::setup_context(db_handler_ptr db, const pipeline_config &cfg) {
 
 	bool status = true;
 	try {
-		db_ = db_handler_ptr(new SQLiteHandler("sqlite.db"));
+		db_ = db ? db : db_handler_ptr(new SQLiteHandler("sqlite.db"));
 		status &= db_->db_setup();
+		pipeline_config pcfg = cfg;
+		if (pcfg.cpus.empty()) { pcfg.cpus = get_affinity().storage; }
+		pipeline_ = result_pipeline_ptr(new ResultPipeline(db_, pcfg));
+		pipeline_->set_persist_observer([this](const StoreRecord *recs, size_t n, unsigned long long us) {
+			timing_->persist.record(us);
+			lock_guard<mutex> lock(mu_registry_);
+			for (size_t i = 0; i < n; ++i) {
+				auto it = registry_.find(recs[i].tid);
+				if (it != registry_.end()) { it->second->get_timing()->record_persist(us); }
+				else {
+					auto pt = pooled_timing_.find(recs[i].tid);
+					if (pt != pooled_timing_.end()) { pt->second->record_persist(us); }
+				}
+			}
+		});
+		// a result evicted from the full queue is no longer stored: correct its status
+		auto sinks = sinks_;
+		pipeline_->set_evict_observer([sinks](const ResultRecord &r) {
+			ResultRecord rec = r;
+			rec.status = RESULT_STORE_FAILED;
+			sinks->publish(rec);
+		});
+		status &= pipeline_->start();
 	}
 	catch (...) {
 		status = false;
 	}
 	return status;
 }
-size_t TaskScheduler::add_task(size_t period, task_work_ptr &work, string desc) {
-	// check validity
-	if (!period || !work) {
-		return 0; 
+
+bool TaskScheduler::get_task_timing(size_t tid, timing_snapshot &s) {
+	task_timing_ptr timing;
+	{
+		lock_guard<mutex> lock(mu_registry_);
+		auto it = registry_.find(tid);
+		if (it != registry_.end()) { timing = it->second->get_timing(); }
+		else {
+			auto pt = pooled_timing_.find(tid);
+			if (pt == pooled_timing_.end()) {
+				return false;
+			}
+			timing = pt->second;
+		}
 	}
+	s = timing->snapshot();
+	return true;
+}
+
+void TaskScheduler::set_clock(clock_ptr clock) {
+	lock_guard<mutex> lock(mu_dpool_);
+	task_clock_ = clock ? clock : Clock::system();
+}
+
+clock_ptr TaskScheduler::get_clock() {
+	lock_guard<mutex> lock(mu_dpool_);
+	return task_clock_;
+}
+
+void TaskScheduler::set_affinity(const affinity_config &cfg) {
+	lock_guard<mutex> lock(mu_dpool_);
+	affinity_ = cfg;
+	set_cpus(cfg.dispatcher);
+}
+
+affinity_config TaskScheduler::get_affinity() {
+	lock_guard<mutex> lock(mu_dpool_);
+	return affinity_;
+}
+
+void TaskScheduler::set_phase_policy(phase_policy policy) {
 	lock_guard<mutex> lock(mu_dpool_);
-	updated_ = false;
-	size_t tid = ++task_counter;
-	dyn_task_pool_.emplace_back(task_container_ptr(new Task(db_, period, tid, work, desc)));
-	task_pool_.emplace(tid, dyn_task_pool_.back());
-	updated_ = true;
+	phase_policy_ = policy;
+}
+
+Clock::duration TaskScheduler::assign_phase(size_t tid, Clock::duration period) {
+	Clock::duration::rep p = period.count();
+	switch (phase_policy_) {
+	case PHASE_HASH: {
+		uint64_t h = tid + 0x9E3779B97F4A7C15ull;		/* splitmix64 finalizer */
+		h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+		h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+		h ^= h >> 31;
+		return Clock::duration(static_cast<Clock::duration::rep>(h % static_cast<uint64_t>(p)));
+	}
+	case PHASE_SPREAD:
+		return spread_phase(p, phase_counts_[p]++);
+	default:
+		return NO_PHASE;
+	}
+}
+
+size_t TaskScheduler::rebalance() {
+	TraceScope span(TRACE_COMMAND, 0, 0, TRACE_CMD_REBALANCE);
+	struct placed { Clock::duration period; task_slot s; };
+	vector<placed> tasks;
+	{
+		lock_guard<mutex> lock(mu_dpool_);
+		for (auto &s : slots_) {
+			if (s.tid) { tasks.push_back(placed{ Clock::duration::zero(), s }); }
+		}
+	}
+	// pools are locked while their works run: periods and phases set without `mu_dpool_`
+	for (auto &t : tasks) {
+		t.period = t.s.task ? t.s.task->get_period() : t.s.pool->get_period(t.s.pool_slot, t.s.tid);
+	}
+	tasks.erase(remove_if(tasks.begin(), tasks.end(), [](const placed &t) { 
+		return t.period <= Clock::duration::zero(); }), tasks.end());
+	sort(tasks.begin(), tasks.end(), [](const placed &a, const placed &b) {
+		return a.period != b.period ? a.period < b.period : a.s.tid < b.s.tid;
+	});
+	unordered_map<Clock::duration::rep, uint32_t> counts;
+	for (size_t first = 0, last; first < tasks.size(); first = last) {
+		Clock::duration period = tasks[first].period;
+		for (last = first; last < tasks.size() && tasks[last].period == period; ++last) {}
+		Clock::duration::rep p = period.count(), n = last - first;
+		// the sequence of PHASE_SPREAD, so that tasks added afterwards continue it from `n`
+		for (size_t i = first; i < last; ++i) {
+			Clock::duration phase = spread_phase(p, static_cast<uint32_t>(i - first));
+			const task_slot &s = tasks[i].s;
+			if (s.task) { s.task->set_phase(phase); }
+			else { s.pool->set_phase(s.pool_slot, s.tid, phase); }
+		}
+		counts[p] = static_cast<uint32_t>(n);
+	}
+	{
+		lock_guard<mutex> lock(mu_dpool_);
+		phase_counts_.swap(counts);
+	}
+	span.arg = static_cast<uint32_t>(tasks.size());
+	log_info("rebalance %zd tasks", tasks.size());
+	return tasks.size();
+}
+
+void TaskScheduler::set_default_slack(const task_slack &slack) {
+	lock_guard<mutex> lock(mu_dpool_);
+	default_slack_ = slack;
+}
+
+bool TaskScheduler::set_slack(size_t tid, const task_slack &slack) {
+	task_slot s;
+	return copy_slot(tid, s) && set_slack_slot(slack, s);
+}
+
+bool TaskScheduler::set_slack(const task_handle &h, const task_slack &slack) {
+	task_slot s;
+	return copy_slot(h, s) && set_slack_slot(slack, s);
+}
+
+bool TaskScheduler::set_slack_slot(const task_slack &slack, const task_slot &s) {
+	if (s.task) { s.task->set_slack(slack); }
+	else { s.pool->set_slack(s.pool_slot, s.tid, slack); }
+	return true;
+}
+
+bool TaskScheduler::set_precision(size_t tid, const precision_config &cfg) {
+	task_slot s;
+	return copy_slot(tid, s) && set_precision_slot(cfg, s);
+}
+
+bool TaskScheduler::set_precision(const task_handle &h, const precision_config &cfg) {
+	task_slot s;
+	return copy_slot(h, s) && set_precision_slot(cfg, s);
+}
+
+bool TaskScheduler::set_precision_slot(const precision_config &cfg, const task_slot &s) {
+	if (s.task) { s.task->set_precision(cfg); }
+	else { s.pool->set_precision(cfg); }
+	return true;
+}
+
+timing_snapshot TaskScheduler::get_timing() {
+	return timing_->snapshot();
+}
+
+void TaskScheduler::copy_tasks(vector<task_container_ptr> &out) {
+	out.clear();
+	lock_guard<mutex> lock(mu_registry_);
+	for (auto &p : registry_) { out.push_back(p.second); }
+}
+
+void TaskScheduler::copy_pooled_tasks(vector<pooled_task> &out) {
+	out.clear();
+	vector<task_pool_ptr> pools;
+	{
+		lock_guard<mutex> lock(mu_dpool_);
+		pools = pools_;
+	}
+	for (auto &pool : pools) { pool->copy_tasks(out); }
+}
+
+void TaskScheduler::copy_task_values(vector<task_values> &out) {
+	if (pipeline_) { pipeline_->copy_values(out); }
+	else { out.clear(); }
+}
+
+bool TaskScheduler::start_metrics_server(unsigned short port) {
+	if (metrics_) {
+		return false;
+	}
+	auto server = make_shared<MetricsServer>(this, port);
+	server->set_cpus(get_affinity().io);
+	if (!server->open()) {
+		return false;
+	}
+	metrics_ = server;
+	return true;
+}
+
+void TaskScheduler::set_tracing(bool on) {
+	Tracer::get().set_enabled(on);
+}
+
+bool TaskScheduler::dump_trace(const string &path) {
+	return Tracer::get().dump_chrome_json(path);
+}
+
+bool TaskScheduler::start_capture(const string &path) {
+	if (!capture_->start(path.c_str(), get_clock())) {
+		return false;
+	}
+	{
+		lock_guard<mutex> lock(mu_dpool_);
+		for (auto &s : slots_) {
+			if (!s.task) continue;
+			capture_->record_add(s.tid, s.task->get_period(), s.task->get_name());
+			if (s.task->is_paused()) { capture_->record_pause(s.tid); }
+		}
+	}
+	vector<pooled_task> tasks;
+	copy_pooled_tasks(tasks);
+	for (auto &t : tasks) {
+		capture_->record_add(t.tid, t.period, *t.name);
+		if (t.paused) { capture_->record_pause(t.tid); }
+	}
+	return true;
+}
+
+void TaskScheduler::stop_capture() {
+	capture_->stop();
+}
+
+pipeline_stats TaskScheduler::get_pipeline_stats() {
+	return pipeline_ ? pipeline_->get_stats() : pipeline_stats();
+}
+task_handle TaskScheduler::add_task(Clock::duration period, task_work &&work, string desc, 
+	string group) {
+	// check validity; results need the pipeline of `setup_context`
+	if (period <= Clock::duration::zero() || !work || !pipeline_) {
+		return task_handle(); 
+	}
+	TraceScope span(TRACE_COMMAND, 0, 0, TRACE_CMD_ADD);
+	lock_guard<mutex> lock(mu_dpool_);
+	size_t tid = next_tid();
+	span.set_id(tid);
+	if (!group.empty()) { dispatcher_->set_group(tid, group); }
+	pipeline_->register_task(tid, desc);
+	// task and its control block from a slab: add/cancel churn reuses the same blocks; timing
+	// (~2KB) from the heap, as slabs are never returned to it
+	auto timing = make_shared<TaskTiming>(timing_);
+	dyn_task_pool_.emplace_back(allocate_shared<Task>(SlabAllocator<Task>(), task_clock_, pipeline_, 
+		sinks_, timing, capture_, period, tid, std::move(work), desc));
+	dyn_task_pool_.back()->set_cpus(affinity_.workers);
+	Clock::duration phase = assign_phase(tid, period);
+	if (phase != NO_PHASE) { dyn_task_pool_.back()->set_phase(phase); }
+	dyn_task_pool_.back()->set_slack(default_slack_);
+	capture_->record_add(tid, period, desc);
+	{
+		lock_guard<mutex> rlock(mu_registry_);
+		registry_.emplace(tid, dyn_task_pool_.back());
+	}
+	task_handle h = alloc_slot(tid);
+	slots_[h.index_].task = dyn_task_pool_.back();
 	cv_dpool_.notify_all();
 
-	return tid;
+	return h;
 }
 
-task_scheduler_ptr TaskScheduler::scheduler_ = nullptr;
-void TaskScheduler::pause_task(size_t tid) {
-	if (task_pool_.find(tid) == task_pool_.end()) {
-		return;
+task_handle TaskScheduler::alloc_slot(size_t tid) {
+	uint32_t index;
+	if (!free_slots_.empty()) {
+		index = free_slots_.back();
+		free_slots_.pop_back();
+	}
+	else {
+		index = static_cast<uint32_t>(slots_.size());
+		slots_.push_back(task_slot{ 0, 1, 0, nullptr, nullptr });
 	}
-	task_pool_[tid]->pause();
+	slots_[index].tid = tid;
+	tid_slot_.emplace(tid, index);
+	return task_handle(index, slots_[index].generation, tid);
 }
 
-void TaskScheduler::resume_task(size_t tid) {
-	if (task_pool_.find(tid) == task_pool_.end()) {
-		return;
+TaskScheduler::task_slot *TaskScheduler::find_slot(size_t tid) {
+	auto it = tid_slot_.find(tid);
+	return it == tid_slot_.end() ? nullptr : &slots_[it->second];
+}
+
+task_handle TaskScheduler::register_pooled(task_pool_ptr pool, Clock::duration period, const string &desc, 
+	const string &group, task_timing_ptr &timing, task_name_ptr &name) {
+	size_t tid = next_tid();
+	TraceScope span(TRACE_COMMAND, tid, 0, TRACE_CMD_ADD);
+	if (!group.empty()) { dispatcher_->set_group(tid, group); }
+	name = pipeline_->register_task(tid, desc);
+	timing = make_shared<TaskTiming>(timing_);
+	capture_->record_add(tid, period, desc);
+	{
+		lock_guard<mutex> rlock(mu_registry_);
+		pooled_timing_.emplace(tid, timing);
 	}
-	task_pool_[tid]->resume();
+	task_handle h = alloc_slot(tid);
+	slots_[h.index_].pool = pool;
+	return h;
+}
+
+void TaskScheduler::add_sink(result_sink_ptr sink) {
+	if (sink) { sinks_->add(sink); }
+}
+
+void TaskScheduler::remove_sink(result_sink_ptr sink) {
+	sinks_->remove(sink);
+}
+
+void TaskScheduler::start_dispatching() {
+	if (!dispatching_.exchange(true)) {
+		dispatcher_->start();
+		add_sink(dispatcher_);
+	}
+}
+
+size_t TaskScheduler::subscribe_task(size_t tid, result_batch_callback cb, size_t max_pending) {
+	size_t sid = dispatcher_->subscribe_task(tid, cb, max_pending);
+	if (sid) { start_dispatching(); }
+	return sid;
+}
+
+size_t TaskScheduler::subscribe_group(const string &group, result_batch_callback cb, 
+	size_t max_pending) {
+	size_t sid = dispatcher_->subscribe_group(group, cb, max_pending);
+	if (sid) { start_dispatching(); }
+	return sid;
+}
+
+size_t TaskScheduler::subscribe_all(result_batch_callback cb, size_t max_pending) {
+	size_t sid = dispatcher_->subscribe_all(cb, max_pending);
+	if (sid) { start_dispatching(); }
+	return sid;
+}
+
+bool TaskScheduler::unsubscribe(size_t sid) {
+	return dispatcher_->unsubscribe(sid);
+}
+
+bool TaskScheduler::get_subscription_stats(size_t sid, subscription_stats &stats) {
+	return dispatcher_->get_stats(sid, stats);
+}
+
+void TaskScheduler::copy_subscription_stats(vector<pair<size_t, subscription_stats>> &out) {
+	dispatcher_->copy_stats(out);
+}
+
+bool TaskScheduler::pause_task(size_t tid) { 
+	task_slot s;
+	return copy_slot(tid, s) && pause_slot(s);
+}
+
+bool TaskScheduler::pause_task(const task_handle &h) { 
+	task_slot s;
+	return copy_slot(h, s) && pause_slot(s);
+}
+
+bool TaskScheduler::pause_slot(const task_slot &s) {
+	if (s.task) { s.task->pause(); }
+	else { s.pool->pause_task(s.pool_slot, s.tid); }
+	capture_->record_pause(s.tid);
+	return true;
+}
+
+bool TaskScheduler::resume_task(size_t tid) { 
+	task_slot s;
+	return copy_slot(tid, s) && resume_slot(s);
 }
 
-bool TaskScheduler::update_task(size_t new_period, size_t tid) {
-	if (task_pool_.find(tid) == task_pool_.end()) {
+bool TaskScheduler::resume_task(const task_handle &h) { 
+	task_slot s;
+	return copy_slot(h, s) && resume_slot(s);
+}
+
+bool TaskScheduler::resume_slot(const task_slot &s) {
+	if (s.task) { s.task->resume(); }
+	else { s.pool->resume_task(s.pool_slot, s.tid); }
+	capture_->record_resume(s.tid);
+	return true;
+}
+
+bool TaskScheduler::update_task(Clock::duration new_period, size_t tid) {
+	task_slot s;
+	return copy_slot(tid, s) && update_slot(new_period, s);
+}
+
+bool TaskScheduler::update_task(Clock::duration new_period, const task_handle &h) {
+	task_slot s;
+	return copy_slot(h, s) && update_slot(new_period, s);
+}
+
+bool TaskScheduler::update_slot(Clock::duration new_period, const task_slot &s) {
+	size_t tid = s.tid;
+	if (new_period <= Clock::duration::zero()) {
 		return false;
 	}
+	uint32_t period_ms = static_cast<uint32_t>(duration_cast<milliseconds>(new_period).count());
+	if (s.pool) {
+		TraceScope span(TRACE_COMMAND, tid, period_ms, TRACE_CMD_UPDATE);
+		s.pool->update_task(s.pool_slot, tid, new_period);
+		capture_->record_update(tid, new_period);
+		return true;
+	}
+	TraceScope span(TRACE_COMMAND, tid, period_ms, TRACE_CMD_UPDATE);
 	try {
-		auto task = task_pool_[tid];
-		auto work = task->get_work();
-		auto task_period = task->get_period();
+		auto task = s.task;
 		
 		lock_guard<mutex> lock(mu_dpool_);
-		pause_task(tid);
-		updated_ = false;
+		task->pause();
 		/*! deleted: replace with a new created thread for each update operation*/
 		//dyn_task_pool_.emplace_back(task_container_ptr(new Task(new_period, tid, work)));
 		//task_pool_[tid] = dyn_task_pool_.back();
 		task->update(new_period);
-		updated_ = true;
-		resume_task(tid);
-		cv_dpool_.notify_all();
+		capture_->record_update(tid, new_period);
+		task->resume();
 	}
 	catch (...) { return false; }
 	return true;
@@ -195,39 +884,98 @@ void TaskScheduler::start() {
 	super::start();
 }
 
+void TaskScheduler::stop() {
+	set_stop(true);
+	{
+		lock_guard<mutex> lock(mu_dpool_);	/* not between the check and the wait of `run` */
+		cv_dpool_.notify_all();
+	}
+	super::stop();
+}
+
 void TaskScheduler::run() {
-	printf("Running TaskScheduler main thread...\n");
+	log_info("Running TaskScheduler main thread...");
+	Tracer::get().name_thread("scheduler");
 	
 	while (!if_stop()) {
 		unique_lock<mutex> locker(mu_dpool_);
-		cv_dpool_.wait(locker, [this] { return updated_ == true; });
+		// nothing to time here: sleep until a command brings tasks or pools to start
+		cv_dpool_.wait(locker, [this] { 
+			return if_stop() || !dyn_task_pool_.empty() || !dyn_pools_.empty(); 
+		});
 		if (!dyn_task_pool_.empty()) {
+			TraceScope span(TRACE_COMMAND, 0, static_cast<uint32_t>(dyn_task_pool_.size()), 
+				TRACE_CMD_START_TASKS);
 			for (auto &t : dyn_task_pool_) {
-				t->start();
+				try {
+					t->start();
+				}
+				catch (const system_error &e) {	// out of threads: task stays registered, idle
+					log_error("start task %zd failed: %s", t->get_task_id(), string(e.what()));
+				}
 			}
 			dyn_task_pool_.clear();
 		}
+		for (auto &pool : dyn_pools_) {
+			try {
+				pool->start();
+			}
+			catch (const system_error &e) {	// tasks of the pool stay registered, idle
+				log_error("start task pool failed: %s", string(e.what()));
+			}
+		}
+		dyn_pools_.clear();
 	}
 
 }
 
-void TaskScheduler::cancel_task(size_t tid) {
-	if (task_pool_.find(tid) == task_pool_.end()) {
-		return;
-	}
-	task_pool_[tid]->stop();
-	task_pool_.erase(tid);
+bool TaskScheduler::cancel_task(size_t tid) { 
+	task_slot s;
+	return claim_slot(tid, s) && cancel_slot(s);
+}
+
+bool TaskScheduler::cancel_task(const task_handle &h) { 
+	task_slot s;
+	return claim_slot(h, s) && cancel_slot(s);
+}
+
+bool TaskScheduler::cancel_slot(const task_slot &s) {
+	size_t tid = s.tid;
+	TraceScope span(TRACE_COMMAND, tid, 0, TRACE_CMD_CANCEL);
+	capture_->record_cancel(tid);
+	if (s.pool) { s.pool->cancel_task(s.pool_slot, tid); }
+	else { s.task->stop(); }
+	dispatcher_->forget_task(tid);
+	pipeline_->forget_task(tid);
+	lock_guard<mutex> lock(mu_registry_);
+	registry_.erase(tid);
+	pooled_timing_.erase(tid);
+	return true;
 }
 
 void TaskScheduler::cancel_all() {
 	vector<size_t> v_tids; 
-	v_tids.reserve(task_pool_.size());
-
-	for (auto &p : task_pool_) { v_tids.push_back(p.first); }
+	{
+		lock_guard<mutex> lock(mu_dpool_);
+		v_tids.reserve(tid_slot_.size());
+		for (auto &p : tid_slot_) { v_tids.push_back(p.first); }
+	}
 	for (auto tid : v_tids) { cancel_task(tid); }
 }
 
 void TaskScheduler::release_context() {
 	cancel_all();	// cancel all task thread
+	stop_capture();
 	stop();			// cancel scheduler thread
+	{
+		lock_guard<mutex> lock(mu_dpool_);
+		for (auto &pool : pools_) { pool->stop(); }
+		pools_.clear();
+		typed_pools_.clear();
+		dyn_pools_.clear();
+	}
+	if (pipeline_) { pipeline_->stop(); }	// store all queued results
+	if (metrics_) { metrics_->stop(); metrics_ = nullptr; }
+	remove_sink(dispatcher_);
+	dispatcher_->stop();	// deliver nothing after release
 }
@@ -6,15 +6,29 @@
 #include <stdlib.h>
 
 #include <vector>
+#include <algorithm>
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
+#include <typeindex>
 #include <thread>
 #include <chrono>
 #include <functional>
+#include <memory>
+#include <string>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include "DBHandler.h"
+#include "ResultSink.h"
+#include "ResultPipeline.h"
+#include "Histogram.h"
+#include "Clock.h"
+#include "WorkloadTrace.h"
+#include "InlineFunction.h"
+#include "SlabAllocator.h"
+#include "Affinity.h"
+#include "TaskTable.h"
 
 using namespace std;
 using namespace chrono;
@@ -22,11 +36,111 @@ using namespace chrono;
 namespace PeriodicTaskScheduler {
 	class Task;
 	class TaskScheduler;
+	class ResultDispatcher;
+	class MetricsServer;
+	class TaskPool;
 	using task_work_ptr = function<float(void)>;		/* task function pointer */
+	const size_t TASK_WORK_INLINE = 64;					/* closure bytes stored without allocation */
+	using task_work = InlineFunction<float(void), TASK_WORK_INLINE>;	/* work owned by a task */
 	using task_container_ptr = shared_ptr<Task>;		/* encapsulated task pointer, used in 
 														two different pools for lookup/update */
 	using task_scheduler_ptr = shared_ptr<TaskScheduler>;	/* used for Task class */
-	using db_handler_ptr = shared_ptr<SQLiteHandler>;	/* shared db handler with all threads */
+	using db_handler_ptr = shared_ptr<StorageBackend>;	/* shared db handler with all threads */
+	using result_sink_ptr = shared_ptr<ResultSink>;		/* extra consumer of task results */
+	using result_sinks_ptr = shared_ptr<ResultSinks>;	/* sinks shared with all threads */
+	using result_batch_callback = function<void(const vector<ResultRecord>&)>;	/* subscriber */
+	using result_dispatcher_ptr = shared_ptr<ResultDispatcher>;
+	using result_pipeline_ptr = shared_ptr<ResultPipeline>;	/* storage path of results */
+	using task_timing_ptr = shared_ptr<TaskTiming>;			/* timing histograms of a task */
+	using task_name_ptr = shared_ptr<const string>;			/* name of a typed task, shared by 
+															its pool and the pipeline */
+	using scheduler_timing_ptr = shared_ptr<SchedulerTiming>;	/* histograms of all tasks */
+	using clock_ptr = shared_ptr<Clock>;					/* time source of tasks */
+	using workload_recorder_ptr = shared_ptr<WorkloadRecorder>;	/* shared with all tasks */
+	using task_pool_ptr = shared_ptr<TaskPool>;				/* thread of typed tasks */
+
+	/* delivery counters of a result subscription */
+	struct subscription_stats {
+		unsigned long long delivered;		/* results passed to the callback */
+		unsigned long long dropped;			/* results dropped since subscriber fell behind */
+	};
+
+	/* where `add_task` places the executions of a new task within its period */
+	enum phase_policy {
+		PHASE_NONE,							/* first execution right away: tasks added together
+											run together */
+		PHASE_HASH,							/* at an offset hashed from the task id */
+		PHASE_SPREAD						/* evenly spaced among the tasks of the same period */
+	};
+
+	/**
+		first time from `now` on that is `phase` past a multiple of `period` since the epoch
+		of the clock: tasks of the same period keep their offsets to each other, whenever 
+		they were added or resumed
+
+		@return time_point			`now` for NO_PHASE
+	*/
+	inline Clock::time_point next_phase(Clock::time_point now, Clock::duration period, 
+		Clock::duration phase) {
+		if (phase < Clock::duration::zero() || period <= Clock::duration::zero()) {
+			return now;
+		}
+		Clock::duration::rep p = period.count(), r = now.time_since_epoch().count();
+		Clock::duration::rep m = ((r - phase.count()) % p + p) % p;	/* past the last one */
+		return m ? now + Clock::duration(p - m) : now;
+	}
+
+	/**
+		due time of the execution after one due at `due` that started at `start`: the first 
+		point after `start` on the grid of `due` and `period`, so that a late execution
+		(missed ones skipped) keeps the task on its phase instead of drifting with `start`
+	*/
+	inline Clock::time_point next_due(Clock::time_point due, Clock::time_point start, 
+		Clock::duration period) {
+		if (start < due + period) {
+			return due + period;
+		}
+		return due + period * ((start - due) / period + 1);
+	}
+
+	/**
+		wakeup of a task due at `due` that may start up to `slack` before or after it: the 
+		first multiple of a power of two ticks (the smallest above `slack`, so at most 
+		2 * `slack`) from `due` - `slack` on. Tasks whose windows overlap get the same 
+		wakeup, and the grids of different slacks nest into each other
+
+		@return time_point			`due` without slack
+	*/
+	inline Clock::time_point coalesce(Clock::time_point due, Clock::duration slack) {
+		if (slack <= Clock::duration::zero()) {
+			return due;
+		}
+		Clock::duration::rep s = slack.count(), g = 1;
+		while (g <= s) { g <<= 1; }
+		Clock::duration::rep r = due.time_since_epoch().count() - s, m = (r % g + g) % g;
+		return Clock::time_point(Clock::duration(m ? r + g - m : r));
+	}
+
+	/**
+		\description opaque reference to a task returned by `add_task`: index of the task's 
+		slot in the scheduler and generation of the slot, so that commands reach the task 
+		with one array access and a handle of a cancelled task is detected (the slot's 
+		generation is increased on cancel). Converts to the numeric task id, kept for the 
+		db, result records and subscriptions
+	*/
+	class task_handle {
+		uint32_t index_{ 0 };
+		uint32_t generation_{ 0 };			/* 0: null handle */
+		size_t tid_{ 0 };
+
+		friend class TaskScheduler;
+		task_handle(uint32_t index, uint32_t generation, size_t tid) : 
+			index_(index), generation_(generation), tid_(tid) {}
+	public:
+		task_handle() {}
+		size_t tid() const { return tid_; }
+		operator size_t() const { return tid_; }
+	};
 	/**
 		\description abstract class for task multi-threading
 		containing a thread for each task instance
@@ -38,6 +152,14 @@ namespace PeriodicTaskScheduler {
 		condition_variable cv_wait_;		/* used for `wait_for` and `stop` thread */
 		mutex mutex_;						/* used for `wait_for` and `stop` thread */
 		atomic<bool> pause_;
+		clock_ptr clock_;					/* all waits and times of the thread */
+		atomic<bool> attached_;				/* counted by `clock_` as a running thread */
+		cpu_list cpus_;						/* pinned to, from the next `start` */
+		precision_config precision_{};		/* of waits, applied by the thread itself; `mutex_` */
+		atomic<bool> precision_changed_;
+		atomic<long long> spin_ns_;			/* spin part of waits, see `set_precision` */
+		int fifo_priority_{ 0 };			/* SCHED_FIFO priority the thread gave itself, 0 if 
+											none; the thread only */
 		
 	protected:
 		/**
@@ -50,10 +172,31 @@ namespace PeriodicTaskScheduler {
 		*/
 		void set_stop(bool v);
 		void set_pause(bool v);
+		/**
+			wait while paused; returns early if stopped
+		*/
 		void guard_pause();
+		/**
+			let `clock_` count this thread from now until its `run` returns or it is stopped; 
+			for threads whose waits take part in simulated time
+		*/
+		void attach_clock();
+		void release_clock();
+		/**
+			spin part of the next wait, 0 for plain waits; applies a changed `set_precision` 
+			to the calling thread first, which must be this thread
+		*/
+		Clock::duration prepare_wait();
+		/**
+			spin until `t` or `wake()`, the end of a hybrid wait
+
+			@return bool				value of `wake()`
+		*/
+		bool spin_until(Clock::time_point t, const Clock::wake_condition &wake);
 		virtual void run() = 0;
 	public:
 		Thread();
+		Thread(clock_ptr clock);
 		virtual ~Thread() noexcept;
 
 		virtual void start();
@@ -68,6 +211,25 @@ namespace PeriodicTaskScheduler {
 		*/
 		template<typename R, typename P>
 		void wait_for(duration<R, P> const& s);
+		/**
+			same as `wait_for`, up to time point `t` of the thread's clock; in precision mode
+			it sleeps until shortly before `t` and spins from there
+		*/
+		void wait_until(Clock::time_point t);
+		clock_ptr get_clock() { return clock_; }
+		/**
+			CPUs the thread is pinned to when started next, see `Affinity::pin_thread`; not
+			pinned if empty
+		*/
+		virtual void set_cpus(const cpu_list &cpus) { cpus_ = cpus; }
+		/**
+			precision mode from the next wait of the thread on: it sleeps until `spin_us` 
+			before each deadline, then spins with a pause instruction until the deadline, 
+			which trades a CPU for wakeups within ~1us. The thread also takes SCHED_FIFO
+			priority and the timer slack of `cfg` where permitted (logged otherwise). No 
+			spinning on a simulated clock
+		*/
+		void set_precision(const precision_config &cfg);
 		
 		/** util functions*/
 		void worker_join();
@@ -90,12 +252,28 @@ namespace PeriodicTaskScheduler {
 	*/
 	class TaskScheduler;
 	class Task : public Thread {
-		size_t period_;					/* task period, in seconds */
+		atomic<Clock::duration::rep> period_;	/* task period, ticks of the clock */
 		size_t tid_;					/* identifier */
-		task_work_ptr work_;			/* working function pointer */
+		task_work work_;				/* working function, called on the task thread only */
 		string tname_;					/* name/description of task */
 
-		db_handler_ptr db_;				/* pointer to db instance */
+		result_pipeline_ptr pipeline_;	/* queues results for storage */
+		result_sinks_ptr sinks_;		/* result consumers besides db */
+		task_timing_ptr timing_;		/* lateness/work histograms */
+		workload_recorder_ptr capture_;	/* work durations, while capturing */
+		atomic<Clock::duration::rep> phase_{ NO_PHASE.count() };	/* see `set_phase` */
+		atomic<bool> rephased_{ false };	/* `phase_` changed since the last execution */
+		atomic<float> slack_fraction_{ 0.f };	/* see `set_slack` */
+		atomic<Clock::duration::rep> slack_absolute_{ 0 };
+
+		/* next execution from `now` on, at the phase of the task */
+		Clock::time_point phase_deadline(Clock::time_point now) {
+			return next_phase(now, get_period(), Clock::duration(phase_.load()));
+		}
+		/* wakeup of an execution due at `due`, coalesced within the slack of the task */
+		Clock::time_point wakeup(Clock::time_point due) {
+			return coalesce(due, get_slack().of(get_period()));
+		}
 		// make task instance non-copyable / non-movable
 		Task(const Task&) = delete;
 		Task(const Task&&) = delete;
@@ -104,45 +282,322 @@ namespace PeriodicTaskScheduler {
 		
 		using super = Thread;
 	public:
-		Task(db_handler_ptr db, size_t period, size_t id, const task_work_ptr &work) :
-			db_(db), period_(period), tid_(id), work_(work) {}
-		Task(db_handler_ptr db, size_t period, size_t id, const task_work_ptr &work, 
-			string name) :	Task(db, period, id, work) { tname_ = name; }
+		Task(clock_ptr clock, result_pipeline_ptr pipeline, result_sinks_ptr sinks, 
+			task_timing_ptr timing, workload_recorder_ptr capture, Clock::duration period, 
+			size_t id, task_work &&work) :
+			super(clock), period_(period.count()), tid_(id), work_(std::move(work)), 
+			pipeline_(pipeline), sinks_(sinks), timing_(timing), capture_(capture) { attach_clock(); }
+		Task(clock_ptr clock, result_pipeline_ptr pipeline, result_sinks_ptr sinks, 
+			task_timing_ptr timing, workload_recorder_ptr capture, Clock::duration period, 
+			size_t id, task_work &&work, string name) :
+			Task(clock, pipeline, sinks, timing, capture, period, id, std::move(work)) { tname_ = name; }
 		~Task() noexcept;
 		/**
-			@return [task_work_ptr work]	work/task function pointers 
+			@return [task_work work]	work/task function
 		*/
-		task_work_ptr get_work();	
+		const task_work &get_work();	
 		
 		// task handlers
 		size_t get_task_id();
-		size_t get_period();
+		Clock::duration get_period() { return Clock::duration(period_.load()); }
+		const string &get_name() { return tname_; }
+		bool is_paused() { return if_pause(); }
+		task_timing_ptr get_timing() { return timing_; }
+		/**
+			run at `phase` past multiples of the period (see `next_phase`) from the next 
+			execution on, at least half a period after it; NO_PHASE: run right away when 
+			started or resumed
+		*/
+		void set_phase(Clock::duration phase) { phase_ = phase.count(); rephased_ = true; }
+		Clock::duration get_phase() { return Clock::duration(phase_.load()); }
+		/**
+			let the task start up to `slack` before or after its due time from its next 
+			wakeup on, at an instant shared with other tasks (see `coalesce`). The next 
+			execution stays due on the grid of the due time, see `next_due`
+		*/
+		void set_slack(const task_slack &slack) {
+			slack_fraction_ = slack.fraction;
+			slack_absolute_ = slack.absolute.count();
+		}
+		task_slack get_slack() {
+			return task_slack{ slack_fraction_.load(), Clock::duration(slack_absolute_.load()) };
+		}
 		virtual void start();
 		virtual void stop();
 		virtual void pause();
 		virtual void resume();
-		virtual void update(size_t new_period);
+		virtual void update(Clock::duration new_period);
 		virtual void run();
 	};
 
+	/* copy of the state of a task of a `TaskPool` */
+	struct pooled_task {
+		size_t tid;
+		Clock::duration period;
+		Clock::time_point deadline;		/* next execution */
+		bool paused;
+		task_timing_ptr timing;
+		task_name_ptr name;				/* shared: copied without allocation */
+	};
+
+	/**
+		\description one thread running all tasks whose work has the same type, see 
+		`TaskScheduler::add_typed_task`. The thread sleeps until the earliest deadline, then 
+		executes every task due in one pass over the `TaskTable`, calling the work objects
+		of the due slots directly (inlinable). Works run with the pool locked: commands on
+		its tasks wait for the pass in progress, and works must not wait on the task clock
+	*/
+	class TaskPool : public Thread {
+		cache_padded<atomic<bool>> changed_{ { false } };	/* tasks changed while waiting;
+														written by command threads */
+		condition_variable cv_;
+		
+		using super = Thread;
+	protected:
+		result_pipeline_ptr pipeline_;
+		result_sinks_ptr sinks_;
+		workload_recorder_ptr capture_;
+		mutex mu_;									/* for `table_` and works */
+		TaskTable table_;
+
+		/**
+			record lateness of `slot` whose work starts at `start`
+
+			@return uint64_t			begin of the work span for the tracer, 0 if off
+		*/
+		uint64_t begin_execution(uint32_t slot, Clock::time_point start);
+		/* record work duration, queue the result and publish it; `slot` is due next on the 
+		grid of its due time, see `next_due` */
+		void end_execution(uint32_t slot, Clock::time_point start, float elapsed, 
+			uint64_t trace_begin);
+		/* tasks added before the thread started are due at `now`, or at their phase */
+		void start_deadlines(Clock::time_point now);
+		/* first execution of `slot` from `now` on, at its phase; `mu_` held */
+		Clock::time_point phase_deadline(uint32_t slot, Clock::time_point now) {
+			return next_phase(now, table_.period(slot), table_.cold(slot).phase);
+		}
+		/* `slot` is due at `due`, its deadline is the wakeup coalesced within its slack; 
+		`mu_` held */
+		void schedule(uint32_t slot, Clock::time_point due) {
+			table_.set_due(slot, due);
+			auto slack = table_.cold(slot).slack.of(table_.period(slot));
+			table_.set_deadline(slot, coalesce(due, slack));
+		}
+		/* wait with `lock` on `mu_` until `t` or a command */
+		void wait_changed(unique_lock<mutex> &lock, Clock::time_point t);
+		/* wake the thread after a change of `table_`; `mu_` held */
+		void notify_changed();
+		/* destroy the work object of `slot`; `mu_` held */
+		virtual void erase_work(uint32_t slot) = 0;
+		/* `tid` is the task at `slot`; `mu_` held */
+		bool holds(uint32_t slot, size_t tid);
+	public:
+		TaskPool(clock_ptr clock, result_pipeline_ptr pipeline, result_sinks_ptr sinks, 
+			workload_recorder_ptr capture) : 
+			super(clock), pipeline_(pipeline), sinks_(sinks), capture_(capture) { attach_clock(); }
+		virtual void start();
+		virtual void stop();
+		/**
+			commands on the task `tid` at `slot` of the table, as returned by `add_task`
+
+			@return bool				false if `tid` is not at `slot` (any more)
+		*/
+		bool update_task(uint32_t slot, size_t tid, Clock::duration new_period);
+		bool pause_task(uint32_t slot, size_t tid);
+		bool resume_task(uint32_t slot, size_t tid);
+		bool cancel_task(uint32_t slot, size_t tid);
+		/* moves the next execution to the phase time closest to it, so that it neither runs
+		twice nor skips a period */
+		bool set_phase(uint32_t slot, size_t tid, Clock::duration phase);
+		/* coalesces the next execution within `slack` already */
+		bool set_slack(uint32_t slot, size_t tid, const task_slack &slack);
+		/* period of the task at `slot`, zero if `tid` is not there */
+		Clock::duration get_period(uint32_t slot, size_t tid);
+		/* append the state of all tasks to `out` */
+		void copy_tasks(vector<pooled_task> &out);
+		/* also keeps the task table on the NUMA node of `cpus` */
+		virtual void set_cpus(const cpu_list &cpus);
+	};
+
+	/**
+		\description `TaskPool` of work objects of type `W`: any nothrow move constructible 
+		type with `float operator()()`. Works are stored by blocks of TaskTable::BLOCK slots, 
+		never moved once added
+	*/
+	template <class W>
+	class TypedTaskPool : public TaskPool {
+		using storage = typename aligned_storage<sizeof(W), alignof(W)>::type;
+		/* work of slot s: works_[s / BLOCK][s % BLOCK]; a block on pages of its own */
+		vector<vector<storage, PageAllocator<storage>>> works_;
+
+		W &work(uint32_t slot) {
+			return *reinterpret_cast<W*>(&works_[slot / TaskTable::BLOCK][slot % TaskTable::BLOCK]);
+		}
+	protected:
+		virtual void erase_work(uint32_t slot) { work(slot).~W(); }
+		/* keep the works of block `b` on the node of the table; `mu_` held */
+		void place_works(size_t b) {
+			Affinity::prefer_node(works_[b].data(), sizeof(storage) * TaskTable::BLOCK, table_.node());
+		}
+	public:
+		using TaskPool::TaskPool;
+		~TypedTaskPool() noexcept {
+			stop();									/* before the works are destroyed */
+			for (uint32_t s = 0; s < table_.slots(); ++s) {
+				if (table_.state(s) != SLOT_FREE) { erase_work(s); }
+			}
+		}
+		/**
+			@return uint32_t			slot of the task, for the other commands
+		*/
+		uint32_t add_task(size_t tid, Clock::duration period, W &&w, task_name_ptr name, 
+			task_timing_ptr timing, Clock::duration phase = NO_PHASE, 
+			const task_slack &slack = NO_SLACK) {
+			lock_guard<mutex> lock(mu_);
+			auto due = next_phase(get_clock()->now(), period, phase);
+			uint32_t slot = table_.insert(tid, period, due, timing, name, phase);
+			table_.set_slack(slot, slack);
+			schedule(slot, due);
+			if (slot / TaskTable::BLOCK == works_.size()) { 
+				works_.emplace_back(static_cast<size_t>(TaskTable::BLOCK));
+				place_works(works_.size() - 1);
+			}
+			new (&works_[slot / TaskTable::BLOCK][slot % TaskTable::BLOCK]) W(std::move(w));
+			notify_changed();
+			return slot;
+		}
+		virtual void set_cpus(const cpu_list &cpus) {
+			TaskPool::set_cpus(cpus);
+			lock_guard<mutex> lock(mu_);
+			for (size_t b = 0; b < works_.size(); ++b) { place_works(b); }
+		}
+		virtual void run() {
+			auto clock = get_clock();
+			unique_lock<mutex> lock(mu_);
+			start_deadlines(clock->now());
+			while (!if_stop()) {
+				auto next = table_.run_due(clock->now(), [&](uint32_t slot) {
+					auto start = clock->now();
+					uint64_t trace_begin = begin_execution(slot, start);
+					float elapsed = work(slot)();
+					end_execution(slot, start, elapsed, trace_begin);
+				});
+				wait_changed(lock, next);
+			}
+		}
+	};
+
 	/*
 		\description The Task Scheduler class, maintaining all tasks and their releated 
 		resources, in the form of shared_ptr container. The class also contains a thread
 		to receive/exec commands from outside
 	*/
 	class TaskScheduler : public Thread {
-		unordered_map<size_t, task_container_ptr> task_pool_;	/* container including all tasks */
+		/* task of a `task_handle`: a thread task, or a typed task of a pool */
+		struct task_slot {
+			size_t tid;							/* 0: free slot */
+			uint32_t generation;				/* of the handles of this slot, from 1 */
+			uint32_t pool_slot;					/* of a typed task, in `pool` */
+			task_container_ptr task;
+			task_pool_ptr pool;
+		};
+		vector<task_slot> slots_;								/* all tasks, by handle index */
+		vector<uint32_t> free_slots_;							/* slots to be reused */
+		unordered_map<size_t, uint32_t> tid_slot_;				/* legacy task id -> slot */
 		vector<task_container_ptr> dyn_task_pool_;				/* newed~~/updated~~ task pool */
-		static task_scheduler_ptr scheduler_;					/* singleton instance */
 		db_handler_ptr db_;										/* DB handler for threads */
+		result_pipeline_ptr pipeline_;							/* results -> aggregate -> db */
+		result_sinks_ptr sinks_{ make_shared<ResultSinks>() };	/* result consumers besides db */
+		result_dispatcher_ptr dispatcher_;						/* delivers results to subscribers */
+		atomic<bool> dispatching_{ false };						/* `dispatcher_` thread started */
+		scheduler_timing_ptr timing_{ make_shared<SchedulerTiming>() };	/* histograms of all tasks */
+		unordered_map<size_t, task_container_ptr> registry_;	/* all tasks, readable from other 
+																threads than the caller's */
+		mutex mu_registry_;										/* for `registry_` */
+		unordered_map<size_t, task_timing_ptr> pooled_timing_;	/* typed tasks, `mu_registry_` */
+		unordered_map<type_index, task_pool_ptr> typed_pools_;	/* pool of new tasks of each work
+																type, `mu_dpool_` */
+		vector<task_pool_ptr> pools_;							/* all pools, `mu_dpool_` */
+		vector<task_pool_ptr> dyn_pools_;						/* pools to be started */
+		shared_ptr<MetricsServer> metrics_;						/* optional OpenMetrics endpoint */
+		clock_ptr task_clock_{ Clock::system() };				/* time source of new tasks */
+		affinity_config affinity_;								/* CPUs of new threads, `mu_dpool_` */
+		phase_policy phase_policy_{ PHASE_NONE };				/* of new tasks, `mu_dpool_` */
+		unordered_map<Clock::duration::rep, uint32_t> phase_counts_;	/* tasks placed per period, for
+																PHASE_SPREAD, `mu_dpool_` */
+		task_slack default_slack_{ NO_SLACK };					/* of new tasks, `mu_dpool_` */
+		workload_recorder_ptr capture_{ make_shared<WorkloadRecorder>() };	/* workload trace */
 		size_t task_counter{ 0 };								/* assigned uid for each new task 
 																will be unchanged after update task */
+		size_t tid_offset_;										/* task ids: tid_offset_ + 1 + */
+		size_t tid_stride_;										/* n * tid_stride_ */
 		/* for dyn_task_pool_ */
-		atomic<bool> updated_{ true };							
 		mutex mu_dpool_;
-		condition_variable cv_dpool_;
+		condition_variable cv_dpool_;							/* tasks or pools to be started */
 
-		TaskScheduler(){}
+		/* id of the next task; `mu_dpool_` held */
+		size_t next_tid() { return tid_offset_ + 1 + task_counter++ * tid_stride_; }
+		/* start `dispatcher_` thread on first subscription */
+		void start_dispatching();
+		/* id, group, pipeline, timing, name and capture of a new typed task; `mu_dpool_` held */
+		task_handle register_pooled(task_pool_ptr pool, Clock::duration period, const string &desc, 
+			const string &group, task_timing_ptr &timing, task_name_ptr &name);
+		/* new slot of task `tid`; `mu_dpool_` held */
+		task_handle alloc_slot(size_t tid);
+		/* phase of new task `tid` by `phase_policy_`; `mu_dpool_` held */
+		Clock::duration assign_phase(size_t tid, Clock::duration period);
+		/* 
+			slot of a live task, nullptr if `tid` is unknown / `h` is stale; `mu_dpool_` held, 
+			valid until it is released (`slots_` may grow)
+		*/
+		task_slot *find_slot(size_t tid);
+		task_slot *find_slot(const task_handle &h) {
+			if (h.index_ >= slots_.size()) {
+				return nullptr;
+			}
+			task_slot *s = &slots_[h.index_];
+			return s->tid && s->generation == h.generation_ ? s : nullptr;
+		}
+		/* copy of the slot of a live task, commands then run without `mu_dpool_` */
+		template <class K>
+		bool copy_slot(const K &key, task_slot &out) {
+			lock_guard<mutex> lock(mu_dpool_);
+			task_slot *s = find_slot(key);
+			if (!s) {
+				return false;
+			}
+			out = *s;
+			return true;
+		}
+		/* copy of the slot of a live task, and free the slot: one caller wins a cancel */
+		template <class K>
+		bool claim_slot(const K &key, task_slot &out) {
+			lock_guard<mutex> lock(mu_dpool_);
+			task_slot *s = find_slot(key);
+			if (!s) {
+				return false;
+			}
+			out = *s;
+			if (out.task) {
+				// `run` starts tasks under `mu_dpool_`: one not started yet never will be
+				auto it = find(dyn_task_pool_.begin(), dyn_task_pool_.end(), out.task);
+				if (it != dyn_task_pool_.end()) { dyn_task_pool_.erase(it); }
+			}
+			s->tid = 0;
+			++s->generation;					/* handles of the task are stale from now */
+			s->task = nullptr;
+			s->pool = nullptr;
+			free_slots_.push_back(static_cast<uint32_t>(s - slots_.data()));
+			tid_slot_.erase(out.tid);
+			return true;
+		}
+		/* commands on the task of a copied slot */
+		bool update_slot(Clock::duration new_period, const task_slot &s);
+		bool pause_slot(const task_slot &s);
+		bool resume_slot(const task_slot &s);
+		bool cancel_slot(const task_slot &s);
+		bool set_slack_slot(const task_slack &slack, const task_slot &s);
+		bool set_precision_slot(const precision_config &cfg, const task_slot &s);
 		TaskScheduler(const TaskScheduler &) = delete;
 		TaskScheduler(const TaskScheduler&&) = delete;
 		TaskScheduler & operator = (const TaskScheduler&)  = delete;
@@ -150,62 +605,301 @@ namespace PeriodicTaskScheduler {
 		
 		using super = Thread;
 	public:		
-		~TaskScheduler() {}
 		/**
-			get static instance 
+			independent scheduler, with its own thread, tasks, storage pipeline, registry and 
+			subscriptions; any number of them may run in one process
+
+			@param tid_offset/tid_stride	ids of its tasks are tid_offset + 1, tid_offset + 1 + 
+										tid_stride, ...: schedulers sharing a storage backend 
+										or a front-end are given disjoint ids, see 
+										`ShardedScheduler`
+		*/
+		explicit TaskScheduler(size_t tid_offset = 0, size_t tid_stride = 1);
+		~TaskScheduler();
+		/**
+			process-wide default instance, created by the first call (thread-safe)
 		*/
 		static task_scheduler_ptr get() {
-			if (scheduler_ == nullptr) {
-				scheduler_ = task_scheduler_ptr(new TaskScheduler());
-			}
-			return scheduler_;
+			static task_scheduler_ptr scheduler = make_shared<TaskScheduler>();
+			return scheduler;
 		}
 		/**
 			prepare for any resources needed, such as db connection, which will be kept open
+
+			@param db_handler_ptr db		storage backend to be used, e.g. SegmentStore; 
+										SQLiteHandler on `sqlite.db` if not given
+			@param pipeline_config cfg	queue sizes/overflow policies between tasks and storage
+			@return bool				return true if backend is ready
+		*/
+		bool setup_context(db_handler_ptr db = nullptr, 
+			const pipeline_config &cfg = pipeline_config());
+		/**
+			time source of tasks added afterwards, `Clock::system()` by default; with a 
+			`VirtualClock`, start the scheduler before advancing the clock, then executions,
+			lateness and result timestamps follow simulated time
+		*/
+		void set_clock(clock_ptr clock);
+		clock_ptr get_clock();
+		/**
+			pin the scheduler thread, task threads and typed task pools, the storage pipeline 
+			threads and the metrics server to the CPUs given for each (e.g. parsed with 
+			`Affinity::parse("node:1")`); task state of the pools is kept on the NUMA node of 
+			their CPUs. Applies to threads started afterwards: call before `setup_context`
+		*/
+		void set_affinity(const affinity_config &cfg);
+		affinity_config get_affinity();
+		/**
+			phase of tasks added afterwards: with PHASE_NONE (default) a new task runs right 
+			away, so tasks added together with the same period run in the same instant of 
+			every period; PHASE_HASH / PHASE_SPREAD place each task at an offset within its 
+			period instead, which flattens the load of bulk imports
+		*/
+		void set_phase_policy(phase_policy policy);
+		/**
+			re-spread all tasks: the tasks of each period are placed within it in id order, as 
+			PHASE_SPREAD places new tasks (gaps within 2x of even, exactly even for a power of 
+			two), and PHASE_SPREAD goes on from there. Typed tasks move at once, thread tasks
+			after their next execution
+
+			@return size_t				number of tasks placed
+		*/
+		size_t rebalance();
+		/**
+			slack of tasks added afterwards, NO_SLACK by default: e.g. `task_slack{ .05f }`
+			lets each task start within +-5% of its period, so that tasks due close together 
+			share one wakeup; with typed tasks, a pool runs them all in one pass. Lateness is 
+			measured from the coalesced wakeup
+		*/
+		void set_default_slack(const task_slack &slack);
+		/**
+			slack of one task, see `Task::set_slack`
+
+			@return bool				false if the task is unknown / cancelled already
+		*/
+		bool set_slack(size_t tid, const task_slack &slack);
+		bool set_slack(const task_handle &h, const task_slack &slack);
+		/**
+			precision mode of the thread running a task (`Thread::set_precision`): of the
+			task thread, or of the pool of a typed task, i.e. of all tasks of its type. 
+			The lateness histograms of the task (`get_task_timing`) give the jitter achieved
+
+			@return bool				false if the task is unknown / cancelled already
+		*/
+		bool set_precision(size_t tid, const precision_config &cfg);
+		bool set_precision(const task_handle &h, const precision_config &cfg);
+		/**
+			snapshot of dispatch lateness, work duration and persist duration histograms 
+			of a task
+
+			@return bool				false if task does not exist
 		*/
-		bool setup_context();
+		bool get_task_timing(size_t tid, timing_snapshot &s);
+		/**
+			snapshot of the histograms of all tasks together
+		*/
+		timing_snapshot get_timing();
+		/**
+			queue depths, drops and batch counters of the storage pipeline
+		*/
+		pipeline_stats get_pipeline_stats();
+		/**
+			copy all registered thread tasks / typed tasks (see `add_typed_task`) / latest 
+			values and aggregates of all tasks into `out`
+		*/
+		void copy_tasks(vector<task_container_ptr> &out);
+		void copy_pooled_tasks(vector<pooled_task> &out);
+		void copy_task_values(vector<task_values> &out);
+		/**
+			serve metrics in OpenMetrics text format on http://127.0.0.1:`port`/metrics, 
+			until `release_context`
+
+			@return bool				false if port cannot be bound
+		*/
+		bool start_metrics_server(unsigned short port);
+		/**
+			record task dispatch, work, db batches, commands and pause/resume of all threads
+			into per-thread rings (latest events are kept); `dump_trace` writes them as 
+			Chrome trace JSON, viewable in chrome://tracing or ui.perfetto.dev
+
+			@return bool				false if `path` cannot be written
+		*/
+		void set_tracing(bool on);
+		bool dump_trace(const string &path);
+		/**
+			capture add/update/cancel/pause/resume commands and the work duration of every
+			execution into `path`, to be replayed offline against another configuration with 
+			`WorkloadReplay`; tasks registered already are recorded as added at the start
+
+			@return bool				false if `path` cannot be written or already capturing
+		*/
+		bool start_capture(const string &path);
+		void stop_capture();
+		/**
+			register/unregister an extra consumer of every task result, e.g. ResultLog;
+			sinks are called from task threads right after each execution
+
+			@param result_sink_ptr sink	sink to be added/removed
+		*/
+		void add_sink(result_sink_ptr sink);
+		void remove_sink(result_sink_ptr sink);
 		/**
 			add a new task to scheduler with running period and related working function pointer
 			
-			@param size_t period		task period
-			@param task_work_ptr &work	function pointer to be run
+			@param size_t period		task period, in seconds; or any `Clock::duration`, e.g. 
+										`milliseconds(5)`
+			@param F &&work				function to be run: any callable returning float, e.g. a 
+										lambda, a function pointer or a `task_work_ptr`; moved 
+										(copied if an lvalue) into the task, without allocation 
+										up to TASK_WORK_INLINE bytes
 			@param desc					name/description of the task
-			@return size_t				return id of new created task; 0 if failed, o.w. > 0
+			@param group				group of the task, used by `subscribe_group`
+			@return task_handle			handle of new created task, converting to its id; 
+										null (id 0) if failed or before `setup_context`
 		*/
-		size_t add_task(size_t period, task_work_ptr &work, string desc = "");
+		template <class F>
+		task_handle add_task(size_t period, F &&work, string desc = "", string group = "") {
+			return add_task(Clock::duration(seconds(period)), task_work(std::forward<F>(work)), desc, group);
+		}
+		template <class F>
+		task_handle add_task(Clock::duration period, F &&work, string desc = "", string group = "") {
+			return add_task(period, task_work(std::forward<F>(work)), desc, group);
+		}
+		task_handle add_task(Clock::duration period, task_work &&work, string desc = "", 
+			string group = "");
+		/**
+			add a task whose work type `W` is known at compile time, e.g. 
+			`add_typed_task(1, PingProbe("8.8.8.8"), "ping")`: all tasks of the same `W` share 
+			one thread and are called directly from an array of `W`, without a thread, an 
+			allocation or an indirect call per task. For large fleets of identical probes
+			whose work is short; a slow work delays the other tasks of its pool. Commands, 
+			timing, results and capture are the same as for `add_task`; typed tasks are 
+			listed by `copy_pooled_tasks`, not by `copy_tasks`
+
+			@param W work				work object, with `float operator()()`
+			@return task_handle			handle of new created task; null if failed
+		*/
+		template <class W>
+		task_handle add_typed_task(size_t period, W work, string desc = "", string group = "") {
+			return add_typed_task(Clock::duration(seconds(period)), std::move(work), desc, group);
+		}
+		template <class W>
+		task_handle add_typed_task(Clock::duration period, W work, string desc = "", 
+			string group = "") {
+			if (period <= Clock::duration::zero() || !pipeline_) {
+				return task_handle();
+			}
+			task_pool_ptr pool;
+			task_timing_ptr timing;
+			task_name_ptr name;
+			task_handle h;
+			Clock::duration phase;
+			task_slack slack;
+			{
+				lock_guard<mutex> lock(mu_dpool_);
+				task_pool_ptr &p = typed_pools_[type_index(typeid(W))];
+				if (!p || p->get_clock() != task_clock_) {
+					// lock of a new pool is free: not started nor shared yet
+					p = make_shared<TypedTaskPool<W>>(task_clock_, pipeline_, sinks_, capture_);
+					p->set_cpus(affinity_.workers);
+					pools_.push_back(p);
+					dyn_pools_.push_back(p);
+					cv_dpool_.notify_all();
+				}
+				pool = p;
+				h = register_pooled(pool, period, desc, group, timing, name);
+				phase = assign_phase(h.tid(), period);
+				slack = default_slack_;
+			}
+			// the pool is locked while its works run: never wait for it holding `mu_dpool_`
+			uint32_t pool_slot = static_cast<TypedTaskPool<W>&>(*pool).add_task(h.tid(), 
+				period, std::move(work), name, timing, phase, slack);
+			{
+				lock_guard<mutex> lock(mu_dpool_);
+				task_slot *s = find_slot(h);
+				if (s) {
+					s->pool_slot = pool_slot;
+					return h;
+				}
+			}
+			pool->cancel_task(pool_slot, h.tid());	/* cancelled by tid meanwhile */
+			return task_handle();
+		}
 		/**
 			update task period with given task id
 
-			@param size_t new_period	period to be used for updating
-			@param size_t tid			task uid
-			@return bool				return true if succeed
+			@param size_t new_period	period to be used for updating, in seconds or as a
+										`Clock::duration`
+			@param size_t tid			task uid, or the handle returned by `add_task`
+			@return bool				return true if succeed; false if the task is unknown, 
+										or cancelled already for a handle
 		*/
-		bool update_task(size_t new_period, size_t tid);
+		bool update_task(size_t new_period, size_t tid) {
+			return update_task(Clock::duration(seconds(new_period)), tid);
+		}
+		bool update_task(size_t new_period, const task_handle &h) {
+			return update_task(Clock::duration(seconds(new_period)), h);
+		}
+		bool update_task(Clock::duration new_period, size_t tid);
+		bool update_task(Clock::duration new_period, const task_handle &h);
+
+		/**
+			subscribe to results of a task / a group of tasks / all tasks; the callback is 
+			invoked with batches of results on a dedicated dispatcher thread, so that a slow 
+			callback never delays task execution. At most `max_pending` undelivered results 
+			are kept for the subscription, older ones are dropped and counted
+
+			@param result_batch_callback cb	called with each batch of results
+			@param size_t max_pending	bound of undelivered results of this subscription
+			@return size_t				subscription id; 0 if failed, o.w. > 0
+		*/
+		size_t subscribe_task(size_t tid, result_batch_callback cb, size_t max_pending = 4096);
+		size_t subscribe_group(const string &group, result_batch_callback cb, 
+			size_t max_pending = 4096);
+		size_t subscribe_all(result_batch_callback cb, size_t max_pending = 4096);
+		/**
+			remove a subscription; a batch being delivered concurrently may still arrive
+		*/
+		bool unsubscribe(size_t sid);
+		/**
+			@return bool				false if `sid` is not subscribed
+		*/
+		bool get_subscription_stats(size_t sid, subscription_stats &stats);
+		/* counters of all subscriptions, by subscription id */
+		void copy_subscription_stats(vector<pair<size_t, subscription_stats>> &out);
 
 		/* override Thread start */
 		virtual void start();
+		/* also wakes the scheduler thread waiting for new tasks */
+		virtual void stop();
 
 		/**
 			stop the task with specified task id
 			
-			@param size_t tid			task uid
+			@param size_t tid			task uid, or the handle returned by `add_task`
+			@return bool				false if the task is unknown / cancelled already
 		*/
-		void cancel_task(size_t tid);
+		bool cancel_task(size_t tid);
+		bool cancel_task(const task_handle &h);
 		
 		/**
-			stop all tasks in `task_pool_`
+			stop all tasks, typed ones included
 		*/
 		void cancel_all();
 		/**
 			pause/resume specified task
-			@param size_t tid			task id to be paused/resumed
+			@param size_t tid			task id / handle of the task to be paused/resumed
+			@return bool				false if the task is unknown / cancelled already
 		*/
-		void pause_task(size_t tid);
+		bool pause_task(size_t tid);
+		bool pause_task(const task_handle &h);
 
-		void resume_task(size_t tid);
+		bool resume_task(size_t tid);
+		bool resume_task(const task_handle &h);
 		
 		/**
-			working context entry point
+			working context entry point: starts the threads of new tasks and pools, and 
+			sleeps otherwise. It times no execution: each task thread and pool sleeps until 
+			its own next deadline
 		*/
 		virtual void run();
 
@@ -0,0 +1,144 @@
+#include "ResultDispatcher.h"
+using namespace PeriodicTaskScheduler;
+
+/*
+	implementation of \class ResultDispatcher
+*/
+
+ResultDispatcher::~ResultDispatcher() noexcept {
+	stop();
+}
+
+void ResultDispatcher::publish(const ResultRecord &r) {
+	bool notify = false;
+	{
+		lock_guard<mutex> lock(mu_subs_);
+		const string *group = nullptr;
+		for (auto &p : subs_) {
+			Subscription &sub = *p.second;
+			bool match = sub.kind == SUB_ALL || (sub.kind == SUB_TASK && sub.tid == r.tid);
+			if (sub.kind == SUB_GROUP) {
+				if (!group) {
+					auto it = groups_.find(static_cast<size_t>(r.tid));
+					if (it == groups_.end()) continue;
+					group = &it->second;
+				}
+				match = *group == sub.group;
+			}
+			if (!match) continue;
+			if (sub.pending.size() >= sub.max_pending) {		// drop oldest, of this one only
+				sub.pending.pop_front();
+				++sub.dropped;
+			}
+			if (sub.pending.empty()) {
+				notify |= ready_.empty();
+				ready_.push_back(p.second);
+			}
+			sub.pending.push_back(r);
+		}
+	}
+	if (notify) { cv_ready_.notify_one(); }
+}
+
+size_t ResultDispatcher::subscribe(int kind, size_t tid, const string &group, 
+	result_batch_callback cb, size_t max_pending) {
+	if (!cb || !max_pending) {
+		return 0;
+	}
+	auto sub = make_shared<Subscription>();
+	sub->kind = kind;
+	sub->tid = tid;
+	sub->group = group;
+	sub->callback = cb;
+	sub->max_pending = max_pending;
+
+	lock_guard<mutex> lock(mu_subs_);
+	sub->sid = ++sid_counter_;
+	subs_.emplace(sub->sid, sub);
+	return sub->sid;
+}
+
+size_t ResultDispatcher::subscribe_task(size_t tid, result_batch_callback cb, size_t max_pending) {
+	return subscribe(SUB_TASK, tid, "", cb, max_pending);
+}
+
+size_t ResultDispatcher::subscribe_group(const string &group, result_batch_callback cb, 
+	size_t max_pending) {
+	return subscribe(SUB_GROUP, 0, group, cb, max_pending);
+}
+
+size_t ResultDispatcher::subscribe_all(result_batch_callback cb, size_t max_pending) {
+	return subscribe(SUB_ALL, 0, "", cb, max_pending);
+}
+
+bool ResultDispatcher::unsubscribe(size_t sid) {
+	lock_guard<mutex> lock(mu_subs_);
+	return subs_.erase(sid) > 0;
+}
+
+bool ResultDispatcher::get_stats(size_t sid, subscription_stats &stats) {
+	lock_guard<mutex> lock(mu_subs_);
+	auto it = subs_.find(sid);
+	if (it == subs_.end()) {
+		return false;
+	}
+	stats.delivered = it->second->delivered;
+	stats.dropped = it->second->dropped;
+	return true;
+}
+
+void ResultDispatcher::copy_stats(vector<pair<size_t, subscription_stats>> &out) {
+	out.clear();
+	lock_guard<mutex> lock(mu_subs_);
+	for (auto &p : subs_) {
+		out.emplace_back(p.first, subscription_stats{ p.second->delivered, p.second->dropped });
+	}
+}
+
+void ResultDispatcher::set_group(size_t tid, const string &group) {
+	lock_guard<mutex> lock(mu_subs_);
+	if (group.empty()) { groups_.erase(tid); }
+	else { groups_[tid] = group; }
+}
+
+void ResultDispatcher::forget_task(size_t tid) {
+	lock_guard<mutex> lock(mu_subs_);
+	groups_.erase(tid);
+}
+
+void ResultDispatcher::stop() {
+	{
+		lock_guard<mutex> lock(mu_subs_);
+		set_stop(true);
+	}
+	cv_ready_.notify_all();
+	super::stop();
+}
+
+void ResultDispatcher::run() {
+	vector<subscription_ptr> ready;
+	vector<deque<ResultRecord>> batches;		/* pending of each of `ready` */
+	vector<ResultRecord> part;
+
+	while (!if_stop()) {
+		{
+			unique_lock<mutex> lock(mu_subs_);
+			cv_ready_.wait(lock, [this] { return if_stop() || !ready_.empty(); });
+			ready.swap(ready_);
+			batches.resize(ready.size());
+			for (size_t i = 0; i < ready.size(); ++i) { batches[i].swap(ready[i]->pending); }
+		}
+		// deliver without holding any lock
+		for (size_t i = 0; i < ready.size(); ++i) {
+			Subscription &sub = *ready[i];
+			deque<ResultRecord> &batch = batches[i];
+			for (size_t first = 0; first < batch.size(); first += max_batch_) {
+				part.assign(batch.begin() + first, batch.begin() + min(batch.size(), first + max_batch_));
+				sub.callback(part);
+			}
+			sub.delivered += batch.size();
+			batch.clear();
+		}
+		ready.clear();
+	}
+}
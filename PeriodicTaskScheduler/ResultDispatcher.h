@@ -0,0 +1,72 @@
+#ifndef _RESULT_DISPATCHER_H_
+#define _RESULT_DISPATCHER_H_
+
+#include <deque>
+#include "PeriodicTaskScheduler.h"
+
+namespace PeriodicTaskScheduler {
+	/**
+		\description delivers task results to in-process subscribers; task threads only
+		append each result to the bounded queue of every matching subscription (`publish`),
+		while a dedicated dispatcher thread invokes the callbacks with batches. A subscriber
+		slower than its result rate loses its oldest results instead of blocking task 
+		threads or growing memory, counted in its `dropped`; the queues of the other 
+		subscriptions are bounded on their own, so they lose nothing while a slow callback
+		delays their delivery, unless their own bound is reached
+	*/
+	class ResultDispatcher : public Thread, public ResultSink {
+		struct Subscription {
+			size_t sid;
+			int kind;							/* SUB_ALL / SUB_TASK / SUB_GROUP */
+			size_t tid;
+			string group;
+			result_batch_callback callback;
+			size_t max_pending;					/* bound of `pending` */
+			deque<ResultRecord> pending;		/* results not delivered yet, `mu_subs_` */
+			atomic<unsigned long long> delivered{ 0 };
+			atomic<unsigned long long> dropped{ 0 };
+		};
+		using subscription_ptr = shared_ptr<Subscription>;
+
+		mutex mu_subs_;							/* guards `subs_`, `groups_`, `sid_counter_`,
+												`ready_` and the `pending` queues */
+		condition_variable cv_ready_;
+		unordered_map<size_t, subscription_ptr> subs_;
+		vector<subscription_ptr> ready_;		/* subscriptions whose `pending` became 
+												non-empty since the last round */
+		unordered_map<size_t, string> groups_;	/* task id -> group */
+		size_t sid_counter_{ 0 };
+		size_t max_batch_;
+
+		size_t subscribe(int kind, size_t tid, const string &group, result_batch_callback cb, 
+			size_t max_pending);
+		using super = Thread;
+	public:
+		enum { SUB_ALL = 0, SUB_TASK = 1, SUB_GROUP = 2 };
+		/**
+			@param max_batch			max results passed to one callback invocation
+		*/
+		ResultDispatcher(size_t max_batch = 1024) : max_batch_(max_batch) {}
+		~ResultDispatcher() noexcept;
+
+		/* ResultSink: called by task threads, never blocks on subscribers */
+		virtual void publish(const ResultRecord &r);
+
+		size_t subscribe_task(size_t tid, result_batch_callback cb, size_t max_pending);
+		size_t subscribe_group(const string &group, result_batch_callback cb, size_t max_pending);
+		size_t subscribe_all(result_batch_callback cb, size_t max_pending);
+		bool unsubscribe(size_t sid);
+		bool get_stats(size_t sid, subscription_stats &stats);
+		/* counters of all subscriptions, by subscription id */
+		void copy_stats(vector<pair<size_t, subscription_stats>> &out);
+
+		/* task id -> group mapping used by group subscriptions */
+		void set_group(size_t tid, const string &group);
+		void forget_task(size_t tid);
+
+		virtual void stop();
+		virtual void run();
+	};
+}
+
+#endif
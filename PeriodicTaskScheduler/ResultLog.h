@@ -0,0 +1,39 @@
+#ifndef _RESULT_LOG_H_
+#define _RESULT_LOG_H_
+
+#include <string>
+#include "MappedFile.h"
+#include "ResultSink.h"
+#include "Logger.h"
+
+/**
+	\description sink appending every task result as a fixed-size record into a
+	memory-mapped ring file; external processes tail the file with `ResultLogReader`
+	without touching the db. Once full, the oldest records are overwritten. Reopening
+	a file with the same capacity continues after its last record
+*/
+class ResultLog : public ResultSink {
+	MappedFile file_;
+	std::string path_;
+	uint64_t capacity_;						/* number of records kept in the file */
+public:
+	ResultLog(const char *path, uint64_t capacity = 1 << 16) : path_(path), capacity_(capacity) {}
+	/**
+		create/map the ring file
+
+		@return bool				true if ready for `publish`
+	*/
+	bool open() {
+		if (!capacity_ || !file_.open_write(path_.c_str(), result_ring_bytes(capacity_))) {
+			log_error("open result log %s failed", path_.c_str());
+			return false;
+		}
+		result_ring_init(file_.data(), capacity_);
+		return true;
+	}
+	virtual void publish(const ResultRecord &r) {
+		if (file_.is_open()) { result_ring_push(file_.data(), r); }
+	}
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _RESULT_LOG_READER_H_
+#define _RESULT_LOG_READER_H_
+
+/*
+	reader library for the result log written by `ResultLog`; to be used by other processes
+	on the host, e.g.
+
+		ResultLogReader log;
+		if (log.open("results.log")) {
+			while (running) {
+				log.poll([](const ResultRecord &r) { ... });
+				if (log.lost()) { ... }				// fell behind the writer
+			}
+		}
+
+	records are read straight from the mapped file; build with MappedFile.cpp only
+*/
+
+#include "MappedFile.h"
+#include "ResultRing.h"
+
+class ResultLogReader {
+	MappedFile file_;
+	ResultRingReader ring_;
+public:
+	/**
+		map the log read-only
+
+		@param path					path of the log file
+		@param from_start			also deliver records already in the log
+		@return bool				false if file does not exist or is not a result log
+	*/
+	bool open(const char *path, bool from_start = false) {
+		return file_.open_read(path) && ring_.attach(file_.data(), file_.size(), from_start);
+	}
+	template<typename F>
+	size_t poll(F &&visit, size_t max = SIZE_MAX) { return ring_.poll(visit, max); }
+
+	uint64_t lost() const { return ring_.lost(); }
+	uint64_t backlog() const { return ring_.backlog(); }
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include "ResultPipeline.h"
+#include "Tracer.h"
+#include "SlabAllocator.h"
+
+using namespace std;
+
+/*
+	implementation of \class ResultPipeline
+*/
+
+ResultPipeline::ResultPipeline(shared_ptr<StorageBackend> db, const pipeline_config &cfg) :
+	db_(db), cfg_(cfg), 
+	results_(cfg.result_capacity, cfg.result_policy), 
+	persist_(cfg.persist_capacity, cfg.persist_policy) {
+	if (!cfg_.max_batch) cfg_.max_batch = 1;
+	// results overflowing the result queue are aggregated right away, then spilled
+	results_.set_spill([this](const ResultRecord &r) {
+		function<bool(const StoreRecord&)> spill;
+		StoreRecord rec;
+		load_aggregates(&r, 1);
+		{
+			lock_guard<mutex> lock(mu_agg_);
+			spill = spill_;
+			if (!aggregate(r, rec)) return false;
+		}
+		return spill && spill(rec);
+	});
+	persist_.set_spill([this](const StoreRecord &r) {
+		function<bool(const StoreRecord&)> spill;
+		{
+			lock_guard<mutex> lock(mu_agg_);
+			spill = spill_;
+		}
+		return spill && spill(r);
+	});
+	results_.set_evict([this](const ResultRecord &r) {
+		function<void(const ResultRecord&)> on_evict;
+		{
+			lock_guard<mutex> lock(mu_agg_);
+			on_evict = on_evict_;
+		}
+		if (on_evict) { on_evict(r); }
+	});
+}
+
+ResultPipeline::~ResultPipeline() noexcept {
+	stop();
+}
+
+bool ResultPipeline::start() {
+	bool status = true;
+	if (!cfg_.spill_dir.empty()) {
+		spill_queue_ = make_shared<SpillQueue>(db_, cfg_.spill_dir, cfg_.spill_file_bytes, 
+			cfg_.replay_batch, cfg_.replay_rate);
+		status = spill_queue_->open();
+		if (status) {
+			auto spill = spill_queue_;
+			set_spill([spill](const StoreRecord &r) { return spill->append(r); });
+			// replay only while live records flow freely into storage
+			spill_queue_->set_busy([this] { 
+				return persist_.get_stats().depth > cfg_.persist_capacity / 2; 
+			});
+			spill_queue_->start(cfg_.cpus);
+		}
+	}
+	aggregator_ = thread(&ResultPipeline::aggregate_loop, this);
+	persister_ = thread(&ResultPipeline::persist_loop, this);
+	return status;
+}
+
+void ResultPipeline::stop() {
+	results_.close();
+	if (aggregator_.joinable()) { aggregator_.join(); }
+	persist_.close();
+	if (persister_.joinable()) { persister_.join(); }
+	if (spill_queue_) { spill_queue_->stop(); }
+}
+
+shared_ptr<const string> ResultPipeline::register_task(size_t tid, const string &name) {
+	auto p = allocate_shared<const string>(SlabAllocator<string>(), name);
+	lock_guard<mutex> lock(mu_agg_);
+	tasks_[tid].name = p;
+	return p;
+}
+
+void ResultPipeline::forget_task(size_t tid) {
+	lock_guard<mutex> lock(mu_agg_);
+	tasks_.erase(tid);
+}
+
+void ResultPipeline::set_spill(function<bool(const StoreRecord&)> spill) {
+	lock_guard<mutex> lock(mu_agg_);
+	spill_ = spill;
+}
+
+bool ResultPipeline::submit(const ResultRecord &r) {
+	return results_.push(r);
+}
+
+/* 
+	fetch aggregates of previous runs for tasks of `rs` seen for the first time, so that 
+	they continue as the online average did with the db; db is read without `mu_agg_`
+*/
+void ResultPipeline::load_aggregates(const ResultRecord *rs, size_t n) {
+	vector<size_t> tids;
+	{
+		lock_guard<mutex> lock(mu_agg_);
+		for (size_t i = 0; i < n; ++i) {
+			auto tid = static_cast<size_t>(rs[i].tid);
+			auto it = tasks_.find(tid);
+			if (it != tasks_.end() && !it->second.loaded && 
+				find(tids.begin(), tids.end(), tid) == tids.end()) {
+				tids.push_back(tid);
+			}
+		}
+	}
+	if (tids.empty()) return;
+	vector<TaskAggregate> aggs(tids.size());
+	for (size_t i = 0; i < tids.size(); ++i) {
+		if (!db_->db_last(tids[i], aggs[i])) { aggs[i] = TaskAggregate(); }
+	}
+	lock_guard<mutex> lock(mu_agg_);
+	for (size_t i = 0; i < tids.size(); ++i) {
+		auto it = tasks_.find(tids[i]);
+		if (it != tasks_.end() && !it->second.loaded) {
+			it->second.loaded = true;
+			it->second.agg = aggs[i];
+		}
+	}
+}
+
+/* 
+	update aggregates of `r.tid` with `r`; caller holds `mu_agg_` and loaded aggregates.
+	Returns false for a result of a task forgotten meanwhile (cancelled), to be dropped
+*/
+bool ResultPipeline::aggregate(const ResultRecord &r, StoreRecord &out) {
+	auto it = tasks_.find(static_cast<size_t>(r.tid));
+	if (it == tasks_.end()) {
+		return false;
+	}
+	TaskState &t = it->second;
+	if (!t.loaded) {
+		// forgotten and re-registered meanwhile
+		t.loaded = true;
+		t.agg = TaskAggregate();
+	}
+	TaskAggregate &a = t.agg;
+	if (!a.count) {
+		a.minv = a.maxv = a.avgv = r.value;
+	}
+	else {
+		// mean_n = mean_n-1 + (x_n - mean_n-1)/n
+		a.minv = min(a.minv, r.value);
+		a.maxv = max(a.maxv, r.value);
+		a.avgv = a.avgv + (r.value - a.avgv) / static_cast<float>(a.count + 1);
+	}
+	++a.count;
+	t.last = r.value;
+
+	out.tid = static_cast<size_t>(r.tid);
+	out.timestamp = r.timestamp;
+	out.value = r.value;
+	out.agg = a;
+	out.name = t.name;
+	return true;
+}
+
+void ResultPipeline::aggregate_loop() {
+	Affinity::pin_thread(cfg_.cpus);
+	vector<ResultRecord> in;
+	vector<StoreRecord> out;
+	in.reserve(cfg_.max_batch);
+	out.resize(cfg_.max_batch);
+
+	while (true) {
+		size_t n = results_.pop_batch(in, cfg_.max_batch, chrono::seconds(1));
+		if (!n) {
+			if (results_.drained()) break;
+			continue;
+		}
+		load_aggregates(in.data(), n);
+		size_t m = 0;
+		{
+			lock_guard<mutex> lock(mu_agg_);
+			for (size_t i = 0; i < n; ++i) { m += aggregate(in[i], out[m]); }
+		}
+		for (size_t i = 0; i < m; ++i) { persist_.push(out[i]); }
+		in.clear();
+	}
+}
+
+void ResultPipeline::persist_loop() {
+	Affinity::pin_thread(cfg_.cpus);
+	vector<StoreRecord> batch;
+	batch.reserve(cfg_.max_batch);
+	Tracer::get().name_thread("persist");
+
+	while (true) {
+		size_t n = persist_.pop_batch(batch, cfg_.max_batch, chrono::seconds(1));
+		if (!n) {
+			if (persist_.drained()) break;
+			continue;
+		}
+		++batches_;
+		last_batch_ = n;
+		auto start = chrono::steady_clock::now();
+		bool ok;
+		{
+			TraceScope span(TRACE_DB_BATCH, 0, static_cast<uint32_t>(n));
+			ok = db_->db_write(batch.data(), n);
+			span.set_id(ok);
+		}
+		if (on_persist_) {
+			on_persist_(batch.data(), n, static_cast<unsigned long long>(
+				chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count()));
+		}
+		if (ok) {
+			stored_ += n;
+		}
+		else {
+			store_failed_ += n;
+			function<bool(const StoreRecord&)> spill;
+			{
+				lock_guard<mutex> lock(mu_agg_);
+				spill = spill_;
+			}
+			if (spill) {
+				for (auto &r : batch) { spill(r); }
+			}
+		}
+		batch.clear();
+	}
+}
+
+void ResultPipeline::set_persist_observer(
+	function<void(const StoreRecord*, size_t, unsigned long long)> on_persist) {
+	on_persist_ = on_persist;
+}
+
+void ResultPipeline::set_evict_observer(function<void(const ResultRecord&)> on_evict) {
+	lock_guard<mutex> lock(mu_agg_);
+	on_evict_ = on_evict;
+}
+
+pipeline_stats ResultPipeline::get_stats() {
+	pipeline_stats s;
+	s.result = results_.get_stats();
+	s.persist = persist_.get_stats();
+	s.batches = batches_;
+	s.stored = stored_;
+	s.store_failed = store_failed_;
+	s.last_batch = last_batch_;
+	s.spill = spill_queue_ ? spill_queue_->get_stats() : spill_stats();
+	return s;
+}
+
+size_t ResultPipeline::copy_values(vector<task_values> &out) {
+	out.clear();
+	lock_guard<mutex> lock(mu_agg_);
+	for (auto &p : tasks_) {
+		if (!p.second.agg.count) continue;
+		task_values v;
+		v.tid = p.first;
+		v.last = p.second.last;
+		v.agg = p.second.agg;
+		out.push_back(v);
+	}
+	return out.size();
+}
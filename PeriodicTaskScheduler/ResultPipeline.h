@@ -0,0 +1,151 @@
+#ifndef _RESULT_PIPELINE_H_
+#define _RESULT_PIPELINE_H_
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include "DBHandler.h"
+#include "ResultRing.h"
+#include "BoundedQueue.h"
+#include "SpillQueue.h"
+#include "Affinity.h"
+
+/* buffer sizes and overflow policies of the storage pipeline */
+struct pipeline_config {
+	size_t result_capacity = 1 << 16;						/* results waiting for aggregation */
+	overflow_policy result_policy = OVERFLOW_DROP_OLDEST;	/* task threads never wait by default */
+	size_t persist_capacity = 1 << 16;						/* records waiting for storage */
+	overflow_policy persist_policy = OVERFLOW_BLOCK;		/* backs up into result queue */
+	size_t max_batch = 512;									/* max records per `db_write` */
+	std::string spill_dir;									/* spill failed/overflowed records into
+															this dir and replay them; "": drop */
+	size_t spill_file_bytes = 64 << 20;						/* size of one spill file */
+	size_t replay_batch = 4096;								/* records per replay `db_write` */
+	size_t replay_rate = 20000;								/* max replayed records per second */
+	cpu_list cpus;											/* CPUs of the aggregate, persist and
+															replay threads; empty: any */
+};
+
+/* counters of the storage pipeline */
+struct pipeline_stats {
+	stage_stats result;						/* execute -> aggregate */
+	stage_stats persist;					/* aggregate -> persist */
+	unsigned long long batches;				/* `db_write` calls */
+	unsigned long long stored;				/* records stored */
+	unsigned long long store_failed;		/* records of failed `db_write` calls */
+	size_t last_batch;						/* size of the latest batch */
+	spill_stats spill;						/* all zero without `spill_dir` */
+};
+
+/* latest value and aggregates of a task */
+struct task_values {
+	size_t tid;
+	float last;
+	TaskAggregate agg;
+};
+
+/**
+	\description staged path of task results into storage: 
+		execute (task threads) -> result queue -> aggregate -> persist queue -> persist
+	task threads only `submit` into a bounded queue, so that a stalled disk never delays
+	task execution; the aggregate thread maintains min/max/avg of each task in memory, and 
+	the persist thread writes records in batches. Overflow of each queue is handled by 
+	its `overflow_policy`; OVERFLOW_SPILL hands records to the handler given to `set_spill`,
+	results spilled from the result queue are aggregated on the submitting thread
+*/
+class ResultPipeline {
+	struct TaskState {
+		std::shared_ptr<const std::string> name;
+		TaskAggregate agg;
+		float last;							/* latest value */
+		bool loaded;						/* aggregates of previous runs fetched from db */
+	};
+
+	std::shared_ptr<StorageBackend> db_;
+	pipeline_config cfg_;
+	BoundedQueue<ResultRecord> results_;
+	BoundedQueue<StoreRecord> persist_;
+
+	std::mutex mu_agg_;						/* guards `tasks_` */
+	std::unordered_map<size_t, TaskState> tasks_;
+	std::function<bool(const StoreRecord&)> spill_;
+	std::function<void(const StoreRecord*, size_t, unsigned long long)> on_persist_;
+	std::function<void(const ResultRecord&)> on_evict_;
+	std::shared_ptr<SpillQueue> spill_queue_;	/* default spill, if `spill_dir` is set */
+
+	std::thread aggregator_;
+	std::thread persister_;
+	std::atomic<unsigned long long> batches_{ 0 };
+	std::atomic<unsigned long long> stored_{ 0 };
+	std::atomic<unsigned long long> store_failed_{ 0 };
+	std::atomic<size_t> last_batch_{ 0 };
+
+	void load_aggregates(const ResultRecord *rs, size_t n);
+	bool aggregate(const ResultRecord &r, StoreRecord &out);
+	void aggregate_loop();
+	void persist_loop();
+
+	ResultPipeline(const ResultPipeline&) = delete;
+	ResultPipeline & operator = (const ResultPipeline&) = delete;
+public:
+	ResultPipeline(std::shared_ptr<StorageBackend> db, const pipeline_config &cfg);
+	~ResultPipeline() noexcept;
+
+	/**
+		start stage threads, and spill queue if `spill_dir` is configured
+
+		@return bool				false if spill dir cannot be used
+	*/
+	bool start();
+	/**
+		refuse new results, store everything queued and join stage threads
+	*/
+	void stop();
+	/**
+		set name of a task, used for records of the task; results of tasks not registered 
+		(any more) are dropped
+
+		@return shared_ptr			the name as kept, to be shared by other holders
+	*/
+	std::shared_ptr<const std::string> register_task(size_t tid, const std::string &name);
+	void forget_task(size_t tid);
+	/**
+		queue a legal task result for storage; called by task threads
+
+		@return bool				false if result was dropped by overflow policy
+	*/
+	bool submit(const ResultRecord &r);
+	/**
+		set handler of OVERFLOW_SPILL and of failed batches, replaces the spill queue
+
+		@param spill				returns true if record was saved
+	*/
+	void set_spill(std::function<bool(const StoreRecord&)> spill);
+
+	/**
+		set observer of every stored batch, called on the persist thread
+
+		@param on_persist			called with records of the batch and `db_write` duration (us)
+	*/
+	void set_persist_observer(std::function<void(const StoreRecord*, size_t, unsigned long long)> on_persist);
+	/**
+		set observer of queued results evicted by OVERFLOW_DROP_OLDEST, called on the 
+		submitting thread; `submit` returns true for the new result in that case
+
+		@param on_evict				called with the evicted result, status unchanged
+	*/
+	void set_evict_observer(std::function<void(const ResultRecord&)> on_evict);
+
+	pipeline_stats get_stats();
+	/**
+		copy latest value and aggregates of all tasks with results into `out` (cleared first,
+		its capacity is reused)
+
+		@return size_t				number of tasks copied
+	*/
+	size_t copy_values(std::vector<task_values> &out);
+};
+
+#endif
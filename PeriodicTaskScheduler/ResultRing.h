@@ -0,0 +1,189 @@
+#ifndef _RESULT_RING_H_
+#define _RESULT_RING_H_
+
+/*
+	binary layout of the result ring shared with external processes (mapped file or shared 
+	memory); header-only and free of scheduler/SQLite dependencies so that readers only need
+	this file plus a mapping of the ring
+
+	layout: ResultRingHeader | ResultRingSlot[capacity]
+	writers claim a position `pos` by incrementing `head`, and publish slot `pos % capacity`
+	with seqlock stamps: seq = 2*pos+1 while writing, 2*pos+2 once complete. A writer takes
+	the slot from a complete older stamp with a CAS, so writers of `pos` and `pos + capacity`
+	never write the slot at the same time
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+enum ResultStatus : uint32_t {
+	RESULT_OK = 0,							/* result produced and stored */
+	RESULT_WORK_FAILED = 1,					/* work returned an illegal (negative) value */
+	RESULT_STORE_FAILED = 2					/* result produced but dropped before storage */
+};
+
+/* one task result, fixed size */
+struct ResultRecord {
+	uint64_t tid;							/* task id */
+	uint64_t timestamp;						/* unix time, in milliseconds */
+	float value;							/* value returned by task work */
+	uint32_t status;						/* ResultStatus */
+};
+
+const uint32_t RESULT_RING_MAGIC = 0x474e5252;	/* "RRNG" */
+const uint32_t RESULT_RING_VERSION = 1;
+
+struct ResultRingHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;					/* sizeof(ResultRecord), layout check for readers */
+	uint32_t reserved;
+	uint64_t capacity;						/* number of slots */
+	char pad0_[40];
+	std::atomic<uint64_t> head;				/* next position to be claimed, own cache line */
+	char pad1_[56];
+};
+
+struct ResultRingSlot {
+	std::atomic<uint64_t> seq;
+	ResultRecord rec;
+};
+
+static_assert(sizeof(ResultRingHeader) == 128, "unexpected ring header layout");
+static_assert(sizeof(ResultRingSlot) == 32, "unexpected ring slot layout");
+
+/**
+	size in bytes of a ring with `capacity` slots
+*/
+inline size_t result_ring_bytes(uint64_t capacity) {
+	return sizeof(ResultRingHeader) + static_cast<size_t>(capacity) * sizeof(ResultRingSlot);
+}
+
+/**
+	initialize ring header at `base` unless it already holds a ring of the same capacity,
+	in which case writing continues after the last record
+
+	@return bool				true if an existing ring was kept
+*/
+inline bool result_ring_init(void *base, uint64_t capacity) {
+	ResultRingHeader *h = static_cast<ResultRingHeader*>(base);
+	if (h->magic == RESULT_RING_MAGIC && h->version == RESULT_RING_VERSION &&
+		h->record_size == sizeof(ResultRecord) && h->capacity == capacity) {
+		return true;
+	}
+	memset(base, 0, result_ring_bytes(capacity));
+	h->version = RESULT_RING_VERSION;
+	h->record_size = sizeof(ResultRecord);
+	h->capacity = capacity;
+	h->head.store(0);
+	std::atomic_thread_fence(std::memory_order_release);
+	h->magic = RESULT_RING_MAGIC;
+	return false;
+}
+
+/**
+	append a record; safe for concurrent writers, the oldest record is overwritten once the
+	ring is full. A writer lapped by one `capacity` positions ahead drops its record (it
+	would be overwritten anyway); one lapping a writer still in progress waits for it
+*/
+inline void result_ring_push(void *base, const ResultRecord &r) {
+	ResultRingHeader *h = static_cast<ResultRingHeader*>(base);
+	ResultRingSlot *slots = reinterpret_cast<ResultRingSlot*>(h + 1);
+	uint64_t pos = h->head.fetch_add(1, std::memory_order_relaxed);
+	ResultRingSlot &s = slots[pos % h->capacity];
+	uint64_t cur = s.seq.load(std::memory_order_acquire);
+	for (;;) {
+		if (cur >= 2 * pos + 1) return;		/* a later position owns the slot */
+		if (cur & 1) {						/* an earlier write in progress */
+			std::this_thread::yield();
+			cur = s.seq.load(std::memory_order_acquire);
+			continue;
+		}
+		if (s.seq.compare_exchange_weak(cur, 2 * pos + 1, std::memory_order_acq_rel, 
+			std::memory_order_acquire)) {
+			break;
+		}
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	s.rec = r;
+	s.seq.store(2 * pos + 2, std::memory_order_release);
+}
+
+/**
+	\description reader of a result ring with its own cursor; readers never write to the
+	ring, so any number of them can tail it concurrently. A reader that falls behind by more
+	than `capacity` records skips to the oldest record still available, and the number of
+	skipped records is accounted in `lost()`
+*/
+class ResultRingReader {
+	ResultRingHeader *head_{ nullptr };
+	ResultRingSlot *slots_{ nullptr };
+	uint64_t capacity_{ 0 };
+	uint64_t cursor_{ 0 };					/* next position to be read */
+	uint64_t lost_{ 0 };					/* records overwritten before they were read */
+public:
+	/**
+		attach to a ring mapped at `base`
+
+		@param size					size of the mapping, in bytes
+		@param from_start			start at the oldest available record instead of the newest
+		@return bool				false if mapping does not hold a valid ring
+	*/
+	bool attach(const void *base, size_t size, bool from_start = false) {
+		ResultRingHeader *h = static_cast<ResultRingHeader*>(const_cast<void*>(base));
+		if (!h || size < sizeof(ResultRingHeader) || h->magic != RESULT_RING_MAGIC ||
+			h->version != RESULT_RING_VERSION || h->record_size != sizeof(ResultRecord) ||
+			!h->capacity || size < result_ring_bytes(h->capacity)) {
+			return false;
+		}
+		head_ = h;
+		slots_ = reinterpret_cast<ResultRingSlot*>(h + 1);
+		capacity_ = h->capacity;
+		uint64_t head = h->head.load(std::memory_order_acquire);
+		cursor_ = !from_start ? head : (head > capacity_ ? head - capacity_ : 0);
+		lost_ = 0;
+		return true;
+	}
+
+	/**
+		visit up to `max` new records in order; `visit(const ResultRecord &)`
+
+		@return size_t				number of visited records
+	*/
+	template<typename F>
+	size_t poll(F &&visit, size_t max = SIZE_MAX) {
+		size_t n = 0;
+		while (n < max) {
+			uint64_t head = head_->head.load(std::memory_order_acquire);
+			if (cursor_ >= head) break;
+			if (head - cursor_ > capacity_) {	// overrun: oldest records are gone
+				lost_ += head - capacity_ - cursor_;
+				cursor_ = head - capacity_;
+			}
+			ResultRingSlot &s = slots_[cursor_ % capacity_];
+			uint64_t expect = 2 * cursor_ + 2;
+			uint64_t s1 = s.seq.load(std::memory_order_acquire);
+			if (s1 < expect) break;				// writer of `cursor_` has not finished yet
+			if (s1 > expect) continue;			// slot already reused, re-check head
+			ResultRecord rec = s.rec;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (s.seq.load(std::memory_order_relaxed) != s1) continue;	// overwritten while reading
+			visit(static_cast<const ResultRecord&>(rec));
+			++cursor_; ++n;
+		}
+		return n;
+	}
+
+	uint64_t lost() const { return lost_; }
+	uint64_t cursor() const { return cursor_; }
+	/** number of records published but not read yet */
+	uint64_t backlog() const {
+		uint64_t head = head_->head.load(std::memory_order_acquire);
+		return head > cursor_ ? head - cursor_ : 0;
+	}
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _RESULT_SINK_H_
+#define _RESULT_SINK_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include "ResultRing.h"
+
+/**
+	\description receiver of every task result besides the storage backend; `publish` is
+	called from the task threads right after the result is produced and must not block
+*/
+class ResultSink {
+public:
+	virtual ~ResultSink() noexcept {}
+	virtual void publish(const ResultRecord &r) = 0;
+};
+
+/**
+	\description set of sinks shared by all tasks; the sink list is copy-on-write so that
+	publishing never takes a lock held by `add`/`remove`
+*/
+class ResultSinks {
+	using sink_ptr = std::shared_ptr<ResultSink>;
+	using sink_list = std::vector<sink_ptr>;
+
+	std::shared_ptr<const sink_list> sinks_{ std::make_shared<sink_list>() };
+	std::mutex mutex_;						/* serializes writers of `sinks_` */
+public:
+	void add(const sink_ptr &sink) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto next = std::make_shared<sink_list>(*std::atomic_load(&sinks_));
+		next->push_back(sink);
+		std::atomic_store(&sinks_, std::shared_ptr<const sink_list>(next));
+	}
+	void remove(const sink_ptr &sink) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto next = std::make_shared<sink_list>(*std::atomic_load(&sinks_));
+		next->erase(std::remove(next->begin(), next->end(), sink), next->end());
+		std::atomic_store(&sinks_, std::shared_ptr<const sink_list>(next));
+	}
+	void publish(const ResultRecord &r) {
+		auto sinks = std::atomic_load(&sinks_);
+		for (auto &s : *sinks) { s->publish(r); }
+	}
+};
+
+#endif
@@ -0,0 +1,401 @@
+#include "SegmentStore.h"
+
+#include <string.h>
+#include <chrono>
+#include "Logger.h"
+
+using namespace std;
+
+#pragma warning(disable: 4996 )
+
+namespace {
+	const uint32_t SEG_MAGIC = 0x47535450;	/* "PTSG" */
+	const uint32_t SEG_VERSION = 1;
+
+	/* on-disk header of a sealed segment, followed by `(nbits + 63) / 64` packed words */
+	struct SegmentHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t tid;
+		uint64_t t_first;
+		uint64_t t_last;
+		uint32_t count;
+		uint32_t reserved;
+		uint64_t nbits;
+		float minv;
+		float maxv;
+		double sum;
+	};
+	static_assert(sizeof(SegmentHeader) == 64, "segment header must keep words 8-byte aligned");
+
+	inline int clz32(uint32_t x) {
+		int n = 0;
+		while (!(x & 0x80000000u)) { x <<= 1; ++n; }
+		return n;
+	}
+
+	inline int ctz32(uint32_t x) {
+		int n = 0;
+		while (!(x & 1u)) { x >>= 1; ++n; }
+		return n;
+	}
+
+	inline uint32_t float_bits(float v) { uint32_t b; memcpy(&b, &v, sizeof(b)); return b; }
+	inline float bits_float(uint32_t b) { float v; memcpy(&v, &b, sizeof(v)); return v; }
+
+	/* bit stream writer, bits are packed MSB-first into 64-bit words */
+	class BitWriter {
+		vector<uint64_t> words_;
+		uint64_t nbits_{ 0 };
+	public:
+		void write(uint64_t v, int n) {
+			if (n < 64) v &= (uint64_t(1) << n) - 1;
+			int off = static_cast<int>(nbits_ & 63);
+			if (!off) words_.push_back(0);
+			int room = 64 - off;
+			if (n <= room) {
+				words_.back() |= v << (room - n);
+			}
+			else {
+				int rem = n - room;
+				words_.back() |= v >> rem;
+				words_.push_back(v << (64 - rem));
+			}
+			nbits_ += n;
+		}
+		uint64_t size_bits() const { return nbits_; }
+		const vector<uint64_t> &words() const { return words_; }
+		void clear() { words_.clear(); nbits_ = 0; }
+	};
+
+	class BitReader {
+		const uint64_t *words_;
+		uint64_t pos_{ 0 };
+	public:
+		BitReader(const uint64_t *words) : words_(words) {}
+		uint64_t read(int n) {
+			size_t idx = static_cast<size_t>(pos_ >> 6);
+			int off = static_cast<int>(pos_ & 63), room = 64 - off;
+			uint64_t r;
+			pos_ += n;
+			if (n <= room) {
+				return (words_[idx] << off) >> (64 - n);
+			}
+			int rem = n - room;
+			r = words_[idx] & ((uint64_t(1) << room) - 1);
+			return (r << rem) | (words_[idx + 1] >> (64 - rem));
+		}
+	};
+
+	/* decode `h.count` points of a segment and visit those in [t_from, t_to] */
+	size_t decode(const SegmentHeader &h, const uint64_t *words,
+		unsigned long long t_from, unsigned long long t_to, const SegmentStore::point_visitor &visit) {
+		if (!h.count) return 0;
+		BitReader in(words);
+		size_t visited = 0;
+		int64_t t = static_cast<int64_t>(in.read(64)), delta = 0;
+		uint32_t v = static_cast<uint32_t>(in.read(32));
+		int lead = 0, trail = 0;
+		for (uint32_t i = 0; ; ) {
+			if (static_cast<unsigned long long>(t) >= t_from && static_cast<unsigned long long>(t) <= t_to) {
+				visit(static_cast<unsigned long long>(t), bits_float(v));
+				++visited;
+			}
+			if (++i == h.count) break;
+			// timestamp: delta of delta
+			int64_t dod;
+			if (!in.read(1)) dod = 0;
+			else if (!in.read(1)) dod = static_cast<int64_t>(in.read(7)) - 63;
+			else if (!in.read(1)) dod = static_cast<int64_t>(in.read(9)) - 255;
+			else if (!in.read(1)) dod = static_cast<int64_t>(in.read(12)) - 2047;
+			else dod = static_cast<int32_t>(in.read(32));
+			delta += dod;
+			t += delta;
+			// value: xor with previous value
+			if (in.read(1)) {
+				if (in.read(1)) {
+					lead = static_cast<int>(in.read(5));
+					int sig = static_cast<int>(in.read(5)) + 1;
+					trail = 32 - lead - sig;
+				}
+				v ^= static_cast<uint32_t>(in.read(32 - lead - trail)) << trail;
+			}
+		}
+		return visited;
+	}
+}
+
+/* a sealed, memory-mapped segment; immutable once created */
+struct SegmentStore::Sealed {
+	MappedFile file;
+	const SegmentHeader *head() const { return reinterpret_cast<const SegmentHeader*>(file.data()); }
+	const uint64_t *words() const { return reinterpret_cast<const uint64_t*>(file.data() + sizeof(SegmentHeader)); }
+};
+
+/* per-task series: sealed segments plus the encoder state of the active segment */
+struct SegmentStore::Series {
+	mutex mutex_;
+	vector<shared_ptr<Sealed>> sealed_;
+	BitWriter bits_;
+	SegmentHeader head_;
+	int64_t t_prev_{ 0 };
+	int64_t delta_prev_{ 0 };
+	uint32_t v_prev_{ 0 };
+	int lead_prev_{ -1 };							/* -1: no xor window yet */
+	int trail_prev_{ 0 };
+
+	Series(size_t tid) { reset(tid); }
+	void reset(size_t tid) {
+		memset(&head_, 0, sizeof(head_));
+		head_.magic = SEG_MAGIC;
+		head_.version = SEG_VERSION;
+		head_.tid = tid;
+		bits_.clear();
+		delta_prev_ = 0;
+		lead_prev_ = -1;
+	}
+	/**
+		append one point to active segment
+		@return bool	false if point cannot be encoded into this segment (delta overflow)
+	*/
+	bool append(int64_t t, float value) {
+		uint32_t vb = float_bits(value);
+		if (!head_.count) {
+			bits_.write(static_cast<uint64_t>(t), 64);
+			bits_.write(vb, 32);
+			head_.t_first = static_cast<uint64_t>(t);
+			head_.minv = head_.maxv = value;
+		}
+		else {
+			int64_t delta = t - t_prev_, dod = delta - delta_prev_;
+			if (dod < INT32_MIN || dod > INT32_MAX) return false;
+
+			if (dod == 0) bits_.write(0, 1);
+			else if (dod >= -63 && dod <= 64) { bits_.write(2, 2); bits_.write(dod + 63, 7); }
+			else if (dod >= -255 && dod <= 256) { bits_.write(6, 3); bits_.write(dod + 255, 9); }
+			else if (dod >= -2047 && dod <= 2048) { bits_.write(14, 4); bits_.write(dod + 2047, 12); }
+			else { bits_.write(15, 4); bits_.write(static_cast<uint32_t>(static_cast<int32_t>(dod)), 32); }
+			delta_prev_ = delta;
+
+			uint32_t x = vb ^ v_prev_;
+			if (!x) {
+				bits_.write(0, 1);
+			}
+			else {
+				int lead = clz32(x), trail = ctz32(x);
+				if (lead_prev_ >= 0 && lead >= lead_prev_ && trail >= trail_prev_) {
+					bits_.write(2, 2);
+					bits_.write(x >> trail_prev_, 32 - lead_prev_ - trail_prev_);
+				}
+				else {
+					int sig = 32 - lead - trail;
+					bits_.write(3, 2);
+					bits_.write(lead, 5);
+					bits_.write(sig - 1, 5);
+					bits_.write(x >> trail, sig);
+					lead_prev_ = lead;
+					trail_prev_ = trail;
+				}
+			}
+			head_.minv = min(head_.minv, value);
+			head_.maxv = max(head_.maxv, value);
+		}
+		t_prev_ = t;
+		v_prev_ = vb;
+		head_.t_last = static_cast<uint64_t>(t);
+		head_.sum += value;
+		head_.nbits = bits_.size_bits();
+		++head_.count;
+		return true;
+	}
+};
+
+/*
+	implementation of \class SegmentStore
+*/
+
+SegmentStore::SegmentStore(const char *dir, size_t points_per_segment) :
+	dir_(dir), points_per_segment_(points_per_segment) {}
+
+bool SegmentStore::db_setup() {
+	lock_guard<mutex> lock(mutex_);
+	if (!MappedFile::make_dir(dir_.c_str())) {
+		log_error("create segment dir %s failed", dir_.c_str());
+		return false;
+	}
+	string idx = dir_ + "/segments.idx";
+
+	// replay manifest: map every sealed segment listed in it
+	if (FILE *f = fopen(idx.c_str(), "r")) {
+		char name[256];
+		while (fscanf(f, "%255s", name) == 1) {
+			shared_ptr<Sealed> seg(new Sealed());
+			if (!seg->file.open_read((dir_ + "/" + name).c_str()) ||
+				seg->file.size() < sizeof(SegmentHeader) || seg->head()->magic != SEG_MAGIC ||
+				seg->file.size() - sizeof(SegmentHeader) < (seg->head()->nbits + 63) / 64 * sizeof(uint64_t)) {
+				log_error("skip broken segment %s", name);	/* e.g. truncated by a crash */
+				continue;
+			}
+			size_t tid = static_cast<size_t>(seg->head()->tid);
+			auto &s = series_[tid];
+			if (!s) s.reset(new Series(tid));
+			s->sealed_.push_back(seg);
+
+			unsigned long long t, seq;
+			if (sscanf(name, "%llu-%llu.seg", &t, &seq) == 2) { seg_counter_ = max(seg_counter_, seq + 1); }
+		}
+		fclose(f);
+	}
+	manifest_ = fopen(idx.c_str(), "a");
+	is_open = manifest_ != nullptr;
+	return is_open;
+}
+
+SegmentStore::Series *SegmentStore::get_series(size_t tid) {
+	lock_guard<mutex> lock(mutex_);
+	auto &s = series_[tid];
+	if (!s) s.reset(new Series(tid));
+	return s.get();
+}
+
+bool SegmentStore::db_insert(size_t tid, const char *, float value) {
+	return db_insert(tid, get_timestamp(), value);
+}
+
+bool SegmentStore::db_insert(size_t tid, unsigned long long time, float value) {
+	if (!is_open) return false;
+
+	Series *s = get_series(tid);
+	lock_guard<mutex> lock(s->mutex_);
+	if (!s->append(static_cast<int64_t>(time), value)) {
+		// delta cannot be encoded (e.g. very long pause), start a new segment
+		if (!seal(tid, *s) || !s->append(static_cast<int64_t>(time), value)) return false;
+	}
+	if (s->head_.count >= points_per_segment_) {
+		return seal(tid, *s);
+	}
+	return true;
+}
+
+bool SegmentStore::db_write(const StoreRecord *recs, size_t n) {
+	bool status = true;
+	for (size_t i = 0; i < n; ++i) {
+		status &= db_insert(recs[i].tid, recs[i].timestamp, recs[i].value);
+	}
+	return status;
+}
+
+/* write active segment of `s` to a new segment file and map it; caller holds `s.mutex_` */
+bool SegmentStore::seal(size_t tid, Series &s) {
+	if (!s.head_.count) return true;
+
+	unsigned long long seq;
+	{
+		lock_guard<mutex> lock(mutex_);
+		seq = seg_counter_++;
+	}
+	char name[64];
+	sprintf(name, "%zu-%llu.seg", tid, seq);
+	string path = dir_ + "/" + name;
+
+	FILE *f = fopen(path.c_str(), "wb");
+	if (!f) {
+		log_error("open segment %s failed", path.c_str());
+		return false;
+	}
+	const vector<uint64_t> &words = s.bits_.words();
+	bool ok = fwrite(&s.head_, sizeof(SegmentHeader), 1, f) == 1 &&
+		fwrite(words.data(), sizeof(uint64_t), words.size(), f) == words.size();
+	ok &= fclose(f) == 0;
+
+	shared_ptr<Sealed> seg(new Sealed());
+	if (!ok || !seg->file.open_read(path.c_str())) {
+		log_error("seal segment %s failed", path.c_str());
+		return false;
+	}
+	{
+		lock_guard<mutex> lock(mutex_);
+		fprintf(manifest_, "%s\n", name);
+		fflush(manifest_);
+	}
+	s.sealed_.push_back(seg);
+	s.reset(tid);
+	return true;
+}
+
+vector<pair<size_t, SegmentStore::Series*>> SegmentStore::copy_series() {
+	vector<pair<size_t, Series*>> all;
+	lock_guard<mutex> lock(mutex_);
+	for (auto &p : series_) { all.emplace_back(p.first, p.second.get()); }
+	return all;
+}
+
+bool SegmentStore::seal_all() {
+	bool status = true;
+	for (auto &p : copy_series()) {
+		lock_guard<mutex> lock(p.second->mutex_);
+		status &= seal(p.first, *p.second);
+	}
+	return status;
+}
+
+size_t SegmentStore::scan(size_t tid, unsigned long long t_from, unsigned long long t_to, 
+	const point_visitor &visit) {
+	Series *s = nullptr;
+	{
+		lock_guard<mutex> lock(mutex_);
+		auto it = series_.find(tid);
+		if (it == series_.end()) return 0;
+		s = it->second.get();
+	}
+	// snapshot under lock, decode without it: sealed segments are immutable
+	vector<shared_ptr<Sealed>> sealed;
+	vector<uint64_t> active;
+	SegmentHeader head;
+	{
+		lock_guard<mutex> lock(s->mutex_);
+		sealed = s->sealed_;
+		active = s->bits_.words();
+		head = s->head_;
+	}
+	size_t visited = 0;
+	for (auto &seg : sealed) {
+		const SegmentHeader *h = seg->head();
+		if (h->t_last < t_from || h->t_first > t_to) continue;
+		visited += decode(*h, seg->words(), t_from, t_to, visit);
+	}
+	if (head.count && !(head.t_last < t_from || head.t_first > t_to)) {
+		visited += decode(head, active.data(), t_from, t_to, visit);
+	}
+	return visited;
+}
+
+unsigned long long SegmentStore::bytes_on_disk() {
+	unsigned long long bytes = 0;
+	for (auto &p : copy_series()) {
+		lock_guard<mutex> slock(p.second->mutex_);
+		for (auto &seg : p.second->sealed_) { bytes += seg->file.size(); }
+	}
+	return bytes;
+}
+
+unsigned long long SegmentStore::point_count() {
+	unsigned long long n = 0;
+	for (auto &p : copy_series()) {
+		lock_guard<mutex> slock(p.second->mutex_);
+		for (auto &seg : p.second->sealed_) { n += seg->head()->count; }
+		n += p.second->head_.count;
+	}
+	return n;
+}
+
+unsigned long long SegmentStore::get_timestamp() {
+	return static_cast<unsigned long long>
+		(chrono::duration_cast<chrono::milliseconds>
+		(chrono::system_clock::now().time_since_epoch()).count());
+}
+
+SegmentStore::~SegmentStore() noexcept {
+	if (is_open) seal_all();
+	if (manifest_) fclose(manifest_);
+}
@@ -0,0 +1,85 @@
+#ifndef _SEGMENT_STORE_H_
+#define _SEGMENT_STORE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include "DBHandler.h"
+#include "MappedFile.h"
+
+/**
+	\description columnar time-series backend; each task owns an append-only series whose
+	points are compressed in memory (timestamps: delta-of-delta, values: Gorilla-style XOR
+	of float bits) and sealed every `points_per_segment` points into an immutable segment 
+	file `<dir>/<tid>-<seq>.seg`; sealed segments are memory-mapped and scanned in place.
+	`<dir>/segments.idx` lists all sealed segments and is replayed by `db_setup`.
+
+	note: points still in the active (unsealed) segment are only persisted by `seal_all`
+	or on destruction
+*/
+class SegmentStore : public StorageBackend {
+public:
+	using point_visitor = std::function<void(unsigned long long time, float value)>;
+
+	SegmentStore(const char *dir, size_t points_per_segment = 4096);
+	~SegmentStore() noexcept;
+
+	virtual bool db_setup();
+	/* task names are not kept: series are keyed by task id only */
+	virtual bool db_insert(size_t tid, const char*, float value);
+	/* appends records with their own timestamps */
+	virtual bool db_write(const StoreRecord *recs, size_t n);
+	/**
+		append one point with an explicit timestamp (in milliseconds)
+	*/
+	bool db_insert(size_t tid, unsigned long long time, float value);
+	/**
+		visit all points of task `tid` with `t_from <= time <= t_to`, oldest segment first
+
+		@param size_t tid			task uid
+		@param t_from/t_to			inclusive time range, in milliseconds
+		@param visit				called once for every point in range
+		@return size_t				number of visited points
+	*/
+	size_t scan(size_t tid, unsigned long long t_from, unsigned long long t_to, 
+		const point_visitor &visit);
+	/**
+		seal active segments of all tasks into segment files
+	*/
+	bool seal_all();
+	/** size of all sealed segment files, in bytes */
+	unsigned long long bytes_on_disk();
+	/** number of points in all segments, sealed or not */
+	unsigned long long point_count();
+
+private:
+	struct Sealed;
+	struct Series;
+
+	std::string dir_;
+	size_t points_per_segment_;
+	bool is_open{ false };
+
+	std::mutex mutex_;										/* guards `series_`, `manifest_` */
+	std::unordered_map<size_t, std::unique_ptr<Series>> series_;
+	FILE *manifest_{ nullptr };
+	unsigned long long seg_counter_{ 0 };					/* sequence of next sealed segment */
+
+	static unsigned long long get_timestamp();
+	Series *get_series(size_t tid);
+	/* all series, copied under `mutex_` so that each can be locked without it (`seal` 
+	takes `mutex_` with a series locked) */
+	std::vector<std::pair<size_t, Series*>> copy_series();
+	bool seal(size_t tid, Series &s);
+
+	SegmentStore(const SegmentStore&) = delete;
+	SegmentStore & operator = (const SegmentStore&) = delete;
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "ShardedScheduler.h"
+using namespace PeriodicTaskScheduler;
+
+/*
+	implementation of \class ShardedScheduler
+*/
+
+ShardedScheduler::ShardedScheduler(size_t shards) {
+	if (!shards) { shards = thread::hardware_concurrency(); }
+	if (!shards) { shards = 1; }
+	for (size_t i = 0; i < shards; ++i) {
+		shards_.push_back(make_shared<TaskScheduler>(i, shards));
+	}
+}
+
+ShardedScheduler::~ShardedScheduler() {
+	release_context();
+}
+
+bool ShardedScheduler::setup_context(db_factory make_db, const pipeline_config &cfg) {
+	bool status = true;
+	for (size_t i = 0; i < shards_.size(); ++i) {
+		// shards never share a db file: one writer per SQLite file
+		db_handler_ptr db = make_db ? make_db(i) : 
+			db_handler_ptr(new SQLiteHandler(("sqlite." + to_string(i) + ".db").c_str()));
+		status &= shards_[i]->setup_context(db, cfg);
+	}
+	return status;
+}
+
+void ShardedScheduler::set_clock(clock_ptr clock) {
+	for (auto &s : shards_) { s->set_clock(clock); }
+}
+
+void ShardedScheduler::set_affinity(shard_affinity affinity) {
+	size_t cpus = thread::hardware_concurrency();
+	size_t nodes = static_cast<size_t>(Affinity::node_count());
+	for (size_t i = 0; i < shards_.size(); ++i) {
+		affinity_config cfg;
+		if (affinity == SHARD_PER_CORE && cpus) {
+			cfg.dispatcher = cfg.workers = cpu_list{ static_cast<int>(i % cpus) };
+			cfg.storage = cfg.io = Affinity::node_cpus(Affinity::node_of(cfg.workers));
+		}
+		else if (affinity == SHARD_PER_NODE) {
+			cfg.workers = Affinity::node_cpus(static_cast<int>(i % nodes));
+			cfg.dispatcher = cfg.storage = cfg.io = cfg.workers;
+		}
+		shards_[i]->set_affinity(cfg);
+	}
+}
+
+void ShardedScheduler::set_phase_policy(phase_policy policy) {
+	for (auto &s : shards_) { s->set_phase_policy(policy); }
+}
+
+size_t ShardedScheduler::rebalance() {
+	size_t n = 0;
+	for (auto &s : shards_) { n += s->rebalance(); }
+	return n;
+}
+
+void ShardedScheduler::set_default_slack(const task_slack &slack) {
+	for (auto &s : shards_) { s->set_default_slack(slack); }
+}
+
+void ShardedScheduler::start() {
+	for (auto &s : shards_) { s->start(); }
+}
+
+void ShardedScheduler::release_context() {
+	for (auto &s : shards_) { s->release_context(); }
+}
+
+timing_snapshot ShardedScheduler::get_timing() {
+	timing_snapshot t = shards_[0]->get_timing();
+	for (size_t i = 1; i < shards_.size(); ++i) {
+		timing_snapshot s = shards_[i]->get_timing();
+		t.lateness = t.lateness.merge(s.lateness);
+		t.work = t.work.merge(s.work);
+		t.persist = t.persist.merge(s.persist);
+		t.values = t.values.merge(s.values);
+	}
+	return t;
+}
+
+void ShardedScheduler::add_sink(result_sink_ptr sink) {
+	for (auto &s : shards_) { s->add_sink(sink); }
+}
+
+void ShardedScheduler::remove_sink(result_sink_ptr sink) {
+	for (auto &s : shards_) { s->remove_sink(sink); }
+}
+
+bool ShardedScheduler::update_task(Clock::duration new_period, size_t tid) {
+	auto s = shard_of(tid);
+	return s && s->update_task(new_period, tid);
+}
+
+bool ShardedScheduler::update_task(Clock::duration new_period, const task_handle &h) {
+	auto s = shard_of(h.tid());
+	return s && s->update_task(new_period, h);
+}
+
+bool ShardedScheduler::pause_task(size_t tid) {
+	auto s = shard_of(tid);
+	return s && s->pause_task(tid);
+}
+
+bool ShardedScheduler::pause_task(const task_handle &h) {
+	auto s = shard_of(h.tid());
+	return s && s->pause_task(h);
+}
+
+bool ShardedScheduler::resume_task(size_t tid) {
+	auto s = shard_of(tid);
+	return s && s->resume_task(tid);
+}
+
+bool ShardedScheduler::resume_task(const task_handle &h) {
+	auto s = shard_of(h.tid());
+	return s && s->resume_task(h);
+}
+
+bool ShardedScheduler::cancel_task(size_t tid) {
+	auto s = shard_of(tid);
+	return s && s->cancel_task(tid);
+}
+
+bool ShardedScheduler::cancel_task(const task_handle &h) {
+	auto s = shard_of(h.tid());
+	return s && s->cancel_task(h);
+}
+
+bool ShardedScheduler::set_slack(size_t tid, const task_slack &slack) {
+	auto s = shard_of(tid);
+	return s && s->set_slack(tid, slack);
+}
+
+bool ShardedScheduler::set_slack(const task_handle &h, const task_slack &slack) {
+	auto s = shard_of(h.tid());
+	return s && s->set_slack(h, slack);
+}
+
+bool ShardedScheduler::set_precision(size_t tid, const precision_config &cfg) {
+	auto s = shard_of(tid);
+	return s && s->set_precision(tid, cfg);
+}
+
+bool ShardedScheduler::set_precision(const task_handle &h, const precision_config &cfg) {
+	auto s = shard_of(h.tid());
+	return s && s->set_precision(h, cfg);
+}
+
+void ShardedScheduler::cancel_all() {
+	for (auto &s : shards_) { s->cancel_all(); }
+}
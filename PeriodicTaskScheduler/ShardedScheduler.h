@@ -0,0 +1,133 @@
+#ifndef _SHARDED_SCHEDULER_H_
+#define _SHARDED_SCHEDULER_H_
+
+#include "PeriodicTaskScheduler.h"
+
+namespace PeriodicTaskScheduler {
+	using db_factory = function<db_handler_ptr(size_t shard)>;	/* storage backend of a shard */
+
+	/* CPUs of the threads of each shard, see `ShardedScheduler::set_affinity` */
+	enum shard_affinity {
+		SHARD_UNPINNED = 0,					/* any CPU */
+		SHARD_PER_CORE = 1,					/* shard i on CPU i (mod hardware threads); its 
+											storage and metrics threads on the node of the CPU */
+		SHARD_PER_NODE = 2					/* shard i on the CPUs of NUMA node i (mod nodes) */
+	};
+
+	/**
+		\description front-end distributing tasks across independent `TaskScheduler`s, one
+		per core by default: new tasks go to the shards round robin, and the shard of a task
+		is found from its id alone (shard `i` of `n` owns ids i + 1, i + 1 + n, ...), so that
+		commands on different shards never share a lock, a scheduler thread or a pipeline.
+		Subscriptions and metrics are per shard, through `shard` / `shard_of`
+	*/
+	class ShardedScheduler {
+		vector<task_scheduler_ptr> shards_;
+		atomic<size_t> next_{ 0 };				/* shard of the next new task */
+
+		task_scheduler_ptr next_shard() { return shards_[next_++ % shards_.size()]; }
+
+		ShardedScheduler(const ShardedScheduler&) = delete;
+		ShardedScheduler & operator = (const ShardedScheduler&) = delete;
+	public:
+		/**
+			@param shards				number of schedulers, hardware threads if 0
+		*/
+		explicit ShardedScheduler(size_t shards = 0);
+		~ShardedScheduler();
+
+		size_t shards() const { return shards_.size(); }
+		task_scheduler_ptr shard(size_t i) { return shards_[i]; }
+		/* shard owning task `tid`, nullptr for id 0 */
+		task_scheduler_ptr shard_of(size_t tid) {
+			return tid ? shards_[(tid - 1) % shards_.size()] : nullptr;
+		}
+
+		/**
+			`TaskScheduler::setup_context` of every shard, each with its own storage backend
+
+			@param make_db				backend of shard `i`, e.g. a `SegmentStore` on its own
+										directory; SQLiteHandler on `sqlite.<i>.db` if not given
+			@return bool				true if the backends of all shards are ready
+		*/
+		bool setup_context(db_factory make_db = nullptr,
+			const pipeline_config &cfg = pipeline_config());
+		/* time source of tasks added afterwards, on all shards */
+		void set_clock(clock_ptr clock);
+		/**
+			pin the threads of every shard by `affinity`, through `TaskScheduler::set_affinity`;
+			call before `setup_context`
+		*/
+		void set_affinity(shard_affinity affinity);
+		/* `TaskScheduler::set_phase_policy` of all shards */
+		void set_phase_policy(phase_policy policy);
+		/**
+			`TaskScheduler::rebalance` of all shards, each on its own: tasks of a period are 
+			spread evenly within each shard
+
+			@return size_t				number of tasks placed
+		*/
+		size_t rebalance();
+		/* `TaskScheduler::set_default_slack` of all shards */
+		void set_default_slack(const task_slack &slack);
+		void start();
+		void release_context();
+		/**
+			histograms of all tasks of all shards together
+		*/
+		timing_snapshot get_timing();
+		/* extra result consumer of all shards, called from the task threads of every shard */
+		void add_sink(result_sink_ptr sink);
+		void remove_sink(result_sink_ptr sink);
+
+		/**
+			`TaskScheduler::add_task` / `add_typed_task` on the next shard
+
+			@return task_handle			handle of new created task; null if failed
+		*/
+		template <class F>
+		task_handle add_task(size_t period, F &&work, string desc = "", string group = "") {
+			return next_shard()->add_task(period, std::forward<F>(work), desc, group);
+		}
+		template <class F>
+		task_handle add_task(Clock::duration period, F &&work, string desc = "", string group = "") {
+			return next_shard()->add_task(period, std::forward<F>(work), desc, group);
+		}
+		template <class W>
+		task_handle add_typed_task(size_t period, W work, string desc = "", string group = "") {
+			return next_shard()->add_typed_task(period, std::move(work), desc, group);
+		}
+		template <class W>
+		task_handle add_typed_task(Clock::duration period, W work, string desc = "", 
+			string group = "") {
+			return next_shard()->add_typed_task(period, std::move(work), desc, group);
+		}
+
+		/**
+			commands on the shard owning the task
+
+			@return bool				false if the task is unknown / cancelled already
+		*/
+		bool update_task(size_t new_period, size_t tid) {
+			return update_task(Clock::duration(seconds(new_period)), tid);
+		}
+		bool update_task(size_t new_period, const task_handle &h) {
+			return update_task(Clock::duration(seconds(new_period)), h);
+		}
+		bool update_task(Clock::duration new_period, size_t tid);
+		bool update_task(Clock::duration new_period, const task_handle &h);
+		bool pause_task(size_t tid);
+		bool pause_task(const task_handle &h);
+		bool resume_task(size_t tid);
+		bool resume_task(const task_handle &h);
+		bool cancel_task(size_t tid);
+		bool cancel_task(const task_handle &h);
+		bool set_slack(size_t tid, const task_slack &slack);
+		bool set_slack(const task_handle &h, const task_slack &slack);
+		bool set_precision(size_t tid, const precision_config &cfg);
+		bool set_precision(const task_handle &h, const precision_config &cfg);
+		void cancel_all();
+	};
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _SHM_RESULT_RING_H_
+#define _SHM_RESULT_RING_H_
+
+#include <string>
+#include "MappedFile.h"
+#include "ResultSink.h"
+#include "Logger.h"
+
+/**
+	\description sink publishing every task result into a ring in shared memory, so that
+	local subscriber processes (see `ShmRingSubscriber`) get results right after `work_()`
+	returns, without going through the db. Publishing is lock-free and never waits for
+	subscribers; slow subscribers are overrun, not waited for
+*/
+class ShmResultRing : public ResultSink {
+	MappedFile shm_;
+	std::string name_;
+	uint64_t capacity_;						/* number of records kept in the ring */
+public:
+	ShmResultRing(const char *name, uint64_t capacity = 1 << 16) : name_(name), capacity_(capacity) {}
+	~ShmResultRing() noexcept { close(); }
+	/**
+		create the shared memory object `name` and initialize an empty ring in it
+
+		@return bool				true if ready for `publish`
+	*/
+	bool open() {
+		if (!capacity_ || !shm_.open_shm(name_.c_str(), result_ring_bytes(capacity_), true)) {
+			log_error("open shared memory %s failed", name_.c_str());
+			return false;
+		}
+		// never resume a ring of a previous run: its subscribers are gone
+		reinterpret_cast<ResultRingHeader*>(shm_.data())->magic = 0;
+		result_ring_init(shm_.data(), capacity_);
+		return true;
+	}
+	/**
+		unmap and remove the shared memory object; attached subscribers keep their mapping
+	*/
+	void close() {
+		if (shm_.is_open()) {
+			shm_.close();
+			MappedFile::unlink_shm(name_.c_str());
+		}
+	}
+	virtual void publish(const ResultRecord &r) {
+		if (shm_.is_open()) { result_ring_push(shm_.data(), r); }
+	}
+};
+
+#endif
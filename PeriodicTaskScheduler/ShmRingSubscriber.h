@@ -0,0 +1,71 @@
+#ifndef _SHM_RING_SUBSCRIBER_H_
+#define _SHM_RING_SUBSCRIBER_H_
+
+/*
+	subscriber of the shared memory ring published by `ShmResultRing`, e.g.
+
+		ShmRingSubscriber sub;
+		if (sub.open("/pts_results")) {
+			while (running) {
+				sub.wait([](const ResultRecord &r) { ... }, std::chrono::milliseconds(100));
+				if (sub.overrun()) { ... }		// records were lost, we are too slow
+			}
+		}
+
+	every subscriber keeps its own cursor in its own process; build with MappedFile.cpp only
+*/
+
+#include <chrono>
+#include <thread>
+#include "MappedFile.h"
+#include "ResultRing.h"
+
+class ShmRingSubscriber {
+	MappedFile shm_;
+	ResultRingReader ring_;
+	uint64_t reported_lost_{ 0 };
+public:
+	/**
+		attach read-only to the ring, starting with the next published record
+
+		@param name					shared memory name given to `ShmResultRing`
+		@return bool				false if no ring is published under `name`
+	*/
+	bool open(const char *name) {
+		return shm_.open_shm(name, 0, false) && ring_.attach(shm_.data(), shm_.size());
+	}
+	/**
+		visit all records published since the last call, without blocking
+	*/
+	template<typename F>
+	size_t poll(F &&visit, size_t max = SIZE_MAX) { return ring_.poll(visit, max); }
+	/**
+		visit new records, waiting up to `timeout` for the first one; spins briefly before
+		backing off to keep publish-to-visit latency in the microsecond range
+	*/
+	template<typename F, typename R, typename P>
+	size_t wait(F &&visit, std::chrono::duration<R, P> const &timeout, size_t max = SIZE_MAX) {
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		for (unsigned spin = 0; ; ++spin) {
+			size_t n = ring_.poll(visit, max);
+			if (n || std::chrono::steady_clock::now() >= deadline) return n;
+			if (spin < 1024) continue;
+			if (spin < 4096) std::this_thread::yield();
+			else std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+	/**
+		@return bool				true if records were overwritten before being read since the
+									last call of `overrun`
+	*/
+	bool overrun() {
+		bool r = ring_.lost() != reported_lost_;
+		reported_lost_ = ring_.lost();
+		return r;
+	}
+	/** records lost in total */
+	uint64_t lost() const { return ring_.lost(); }
+	uint64_t backlog() const { return ring_.backlog(); }
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef _SLAB_ALLOCATOR_H_
+#define _SLAB_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+
+/* usage counters of a `SlabPool` */
+struct slab_stats {
+	size_t block_bytes;						/* size of one block */
+	unsigned long long slabs;				/* slabs taken from the heap */
+	unsigned long long blocks;				/* blocks carved from the slabs */
+};
+
+/**
+	\description process-wide pool of fixed-size blocks: blocks are carved from slabs taken
+	from the heap, and are never returned to it. A freed block goes to the freelist of the
+	freeing thread; a thread moves blocks from and to the shared freelist by `BATCH` only,
+	so that objects created and destroyed again and again (tasks added and cancelled) reuse
+	the same memory without locking, and without the global heap. Meant for small objects:
+	the peak number of blocks stays allocated for the life of the process
+*/
+template <size_t Size, size_t Align>
+class SlabPool {
+	static_assert(Align <= alignof(max_align_t), "over-aligned slab blocks");
+
+	struct free_block {
+		free_block *next;
+	};
+	static const size_t ALIGN = Align < alignof(free_block) ? alignof(free_block) : Align;
+	static const size_t BLOCK = ((Size < sizeof(free_block) ? sizeof(free_block) : Size) + ALIGN - 1)
+		/ ALIGN * ALIGN;
+	static const size_t SLAB_BYTES = 64 * 1024;
+	static const size_t SLAB_BLOCKS = SLAB_BYTES / BLOCK < 8 ? 8 : SLAB_BYTES / BLOCK;
+	static const size_t BATCH = SLAB_BLOCKS < 64 ? SLAB_BLOCKS : 64;	/* blocks moved at once */
+
+	/* freelist of one thread, handed to the shared freelist when the thread ends */
+	struct thread_cache {
+		free_block *head = nullptr;
+		size_t count = 0;
+		~thread_cache() {
+			if (head) { SlabPool::get().put_list(head); }
+			head = nullptr;
+			count = 0;
+		}
+	};
+	static thread_cache &cache() {
+		static thread_local thread_cache c;
+		return c;
+	}
+
+	std::mutex mu_;							/* for `free_` */
+	free_block *free_ = nullptr;			/* shared freelist */
+	std::atomic<unsigned long long> slabs_{ 0 };
+
+	void put_list(free_block *head) {
+		free_block *tail = head;
+		while (tail->next) { tail = tail->next; }
+		std::lock_guard<std::mutex> lock(mu_);
+		tail->next = free_;
+		free_ = head;
+	}
+	/* fill the empty freelist `c` from the shared freelist, or from a new slab */
+	void refill(thread_cache &c) {
+		{
+			std::lock_guard<std::mutex> lock(mu_);
+			while (free_ && c.count < BATCH) {
+				free_block *b = free_;
+				free_ = b->next;
+				b->next = c.head;
+				c.head = b;
+				++c.count;
+			}
+		}
+		if (c.head) return;
+		char *slab = static_cast<char*>(::operator new(SLAB_BLOCKS * BLOCK));
+		++slabs_;
+		for (size_t i = SLAB_BLOCKS; i-- > 0; ) {
+			free_block *b = reinterpret_cast<free_block*>(slab + i * BLOCK);
+			b->next = c.head;
+			c.head = b;
+		}
+		c.count = SLAB_BLOCKS;
+		if (c.count > BATCH) { split(c, c.count - BATCH); }
+	}
+	/* give the first `n` blocks of the freelist `c` to the shared freelist */
+	void split(thread_cache &c, size_t n) {
+		free_block *head = c.head, *last = c.head;
+		for (size_t i = 1; i < n; ++i) { last = last->next; }
+		c.head = last->next;
+		c.count -= n;
+		last->next = nullptr;
+		put_list(head);
+	}
+
+	SlabPool() {}
+public:
+	static const size_t block_bytes = BLOCK;
+
+	/* never destroyed: blocks may be freed by threads ending after `main` */
+	static SlabPool &get() {
+		static SlabPool *pool = new SlabPool();
+		return *pool;
+	}
+
+	void *allocate() {
+		thread_cache &c = cache();
+		if (!c.head) { refill(c); }
+		free_block *b = c.head;
+		c.head = b->next;
+		--c.count;
+		return b;
+	}
+	void deallocate(void *p) {
+		thread_cache &c = cache();
+		free_block *b = static_cast<free_block*>(p);
+		b->next = c.head;
+		c.head = b;
+		if (++c.count >= 2 * BATCH) { split(c, BATCH); }
+	}
+	slab_stats get_stats() const {
+		return slab_stats{ BLOCK, slabs_.load(), slabs_.load() * SLAB_BLOCKS };
+	}
+};
+
+/**
+	\description standard allocator drawing single objects from the `SlabPool` of their size,
+	e.g. `allocate_shared<Task>(SlabAllocator<Task>(), ...)` puts the object and its control
+	block into one slab block; arrays go to the heap
+*/
+template <class T>
+class SlabAllocator {
+	using pool = SlabPool<sizeof(T), alignof(T)>;
+public:
+	using value_type = T;
+	template <class U> struct rebind { using other = SlabAllocator<U>; };
+
+	SlabAllocator() noexcept {}
+	template <class U> SlabAllocator(const SlabAllocator<U>&) noexcept {}
+
+	T *allocate(size_t n) {
+		return static_cast<T*>(n == 1 ? pool::get().allocate() : ::operator new(n * sizeof(T)));
+	}
+	void deallocate(T *p, size_t n) noexcept {
+		if (n == 1) { pool::get().deallocate(p); }
+		else { ::operator delete(p); }
+	}
+};
+
+template <class T, class U>
+bool operator==(const SlabAllocator<T>&, const SlabAllocator<U>&) noexcept { return true; }
+template <class T, class U>
+bool operator!=(const SlabAllocator<T>&, const SlabAllocator<U>&) noexcept { return false; }
+
+#endif
@@ -0,0 +1,257 @@
+#include "SpillQueue.h"
+
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include "MappedFile.h"
+#include "Logger.h"
+#include "SlabAllocator.h"
+
+using namespace std;
+
+#pragma warning(disable: 4996 )
+
+namespace {
+	/* fixed part of a spilled record, followed by `name_len` bytes of task name */
+	struct SpillHeader {
+		uint64_t tid;
+		uint64_t timestamp;
+		uint64_t count;
+		float value;
+		float minv;
+		float maxv;
+		float avgv;
+		uint32_t name_len;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(SpillHeader) == 48, "unexpected spill record layout");
+	const uint32_t SPILL_NAME_MAX = 1024;		/* longer task names are cut when spilled */
+
+	const auto REPLAY_TICK = chrono::milliseconds(100);
+	const auto REPLAY_BACKOFF_MAX = chrono::milliseconds(5000);
+}
+
+/*
+	implementation of \class SpillQueue
+*/
+
+SpillQueue::SpillQueue(shared_ptr<StorageBackend> db, const string &dir, size_t file_bytes, 
+	size_t replay_batch, size_t replay_rate) : 
+	db_(db), dir_(dir), file_bytes_(file_bytes), 
+	replay_batch_(replay_batch ? replay_batch : 1), replay_rate_(replay_rate) {}
+
+SpillQueue::~SpillQueue() noexcept {
+	stop();
+	if (writer_) fclose(writer_);
+}
+
+string SpillQueue::file_name(unsigned long long seq) {
+	char name[48];
+	sprintf(name, "/spill-%llu.bin", seq);
+	return dir_ + name;
+}
+
+/* caller holds `mutex_` */
+bool SpillQueue::save_state() {
+	FILE *f = fopen((dir_ + "/spill.state").c_str(), "w");
+	if (!f) return false;
+	fprintf(f, "%llu %llu %llu\n", first_seq_, next_seq_, offset_);
+	return fclose(f) == 0;
+}
+
+/* start a new spill file; caller holds `mutex_` */
+bool SpillQueue::rotate() {
+	if (writer_) { fclose(writer_); writer_ = nullptr; }
+	writer_ = fopen(file_name(next_seq_).c_str(), "ab");
+	if (!writer_) {
+		log_error("open spill file %s failed", file_name(next_seq_).c_str());
+		return false;
+	}
+	++next_seq_;
+	writer_bytes_ = 0;
+	return save_state();
+}
+
+bool SpillQueue::open() {
+	lock_guard<mutex> lock(mutex_);
+	if (!MappedFile::make_dir(dir_.c_str())) {
+		log_error("create spill dir %s failed", dir_.c_str());
+		return false;
+	}
+	if (FILE *f = fopen((dir_ + "/spill.state").c_str(), "r")) {
+		if (fscanf(f, "%llu %llu %llu", &first_seq_, &next_seq_, &offset_) != 3) {
+			first_seq_ = next_seq_ = offset_ = 0;
+		}
+		fclose(f);
+	}
+	// never append to a file of a previous run, it may end with a torn record
+	return rotate();
+}
+
+void SpillQueue::start(const cpu_list &cpus) {
+	stop_ = false;
+	replayer_ = thread([this](cpu_list pin) {
+		Affinity::pin_thread(pin);
+		replay_loop();
+	}, cpus);
+}
+
+void SpillQueue::stop() {
+	{
+		lock_guard<mutex> lock(mutex_);
+		stop_ = true;
+	}
+	cv_stop_.notify_all();
+	if (replayer_.joinable()) { replayer_.join(); }
+	lock_guard<mutex> lock(mutex_);
+	if (writer_) { fflush(writer_); }
+}
+
+void SpillQueue::set_busy(function<bool()> busy) {
+	lock_guard<mutex> lock(mutex_);
+	busy_ = busy;
+}
+
+bool SpillQueue::append(const StoreRecord &r) {
+	SpillHeader h;
+	memset(&h, 0, sizeof(h));
+	h.tid = r.tid;
+	h.timestamp = r.timestamp;
+	h.count = r.agg.count;
+	h.value = r.value;
+	h.minv = r.agg.minv;
+	h.maxv = r.agg.maxv;
+	h.avgv = r.agg.avgv;
+	h.name_len = r.name ? static_cast<uint32_t>(min<size_t>(r.name->size(), SPILL_NAME_MAX)) : 0;
+
+	lock_guard<mutex> lock(mutex_);
+	if (!writer_ || writer_bytes_ >= file_bytes_) {
+		if (!rotate()) return false;
+	}
+	bool ok = fwrite(&h, sizeof(h), 1, writer_) == 1 &&
+		(!h.name_len || fwrite(r.name->data(), 1, h.name_len, writer_) == h.name_len);
+	if (ok) {
+		writer_bytes_ += sizeof(h) + h.name_len;
+		++spilled_;
+	}
+	return ok;
+}
+
+long long SpillQueue::replay_batch() {
+	unsigned long long seq, offset;
+	{
+		lock_guard<mutex> lock(mutex_);
+		if (first_seq_ + 1 >= next_seq_) {
+			// only the file being written is left: hand it over to replay if it has data
+			if (!writer_bytes_) return 0;
+			if (!rotate()) return -1;
+		}
+		else if (writer_) {
+			fflush(writer_);
+		}
+		seq = first_seq_;
+		offset = offset_;
+	}
+	vector<StoreRecord> batch;
+	batch.reserve(replay_batch_);
+	unsigned long long end = offset;
+	bool eof = false;
+
+	FILE *f = fopen(file_name(seq).c_str(), "rb");
+	long size = -1;
+	if (f && !fseek(f, 0, SEEK_END)) { size = ftell(f); }
+	if (f && size >= 0 && !fseek(f, static_cast<long>(offset), SEEK_SET)) {
+		SpillHeader h;
+		string name;
+		while (batch.size() < replay_batch_) {
+			// a name running past the end of the file is a short read too, not allocated
+			if (fread(&h, sizeof(h), 1, f) != 1 || 
+				h.name_len > static_cast<unsigned long long>(size) - end - sizeof(h)) {
+				eof = true;						// end of file (or torn record of a crash)
+				break;
+			}
+			name.resize(h.name_len);
+			if (h.name_len && fread(&name[0], 1, h.name_len, f) != h.name_len) {
+				eof = true;
+				break;
+			}
+			StoreRecord r;
+			r.tid = static_cast<size_t>(h.tid);
+			r.timestamp = h.timestamp;
+			r.value = h.value;
+			r.agg.count = h.count;
+			r.agg.minv = h.minv;
+			r.agg.maxv = h.maxv;
+			r.agg.avgv = h.avgv;
+			r.name = allocate_shared<const string>(SlabAllocator<string>(), name);
+			batch.push_back(r);
+			end += sizeof(h) + h.name_len;
+		}
+	}
+	else {
+		eof = true;								// file is gone, skip it
+	}
+	if (f) fclose(f);
+
+	if (!batch.empty() && !db_->db_write(batch.data(), batch.size())) {
+		++replay_failed_;
+		return -1;
+	}
+	replayed_ += batch.size();
+
+	lock_guard<mutex> lock(mutex_);
+	if (eof) {
+		remove(file_name(seq).c_str());
+		++first_seq_;
+		offset_ = 0;
+	}
+	else {
+		offset_ = end;
+	}
+	save_state();
+	return static_cast<long long>(batch.size()) + (eof ? 1 : 0);
+}
+
+void SpillQueue::replay_loop() {
+	auto backoff = REPLAY_TICK;
+	while (!stop_) {
+		auto wait = REPLAY_TICK;
+		function<bool()> busy;
+		{
+			lock_guard<mutex> lock(mutex_);
+			busy = busy_;
+		}
+		if (!busy || !busy()) {
+			auto start = chrono::steady_clock::now();
+			long long n = replay_batch();
+			if (n < 0) {						// storage still down
+				wait = backoff;
+				backoff = min<chrono::milliseconds>(backoff * 2, REPLAY_BACKOFF_MAX);
+			}
+			else {
+				backoff = REPLAY_TICK;
+				if (n > 0) {
+					// rate limit: a batch of n records takes at least n / replay_rate seconds
+					wait = replay_rate_ ? chrono::milliseconds(n * 1000 / replay_rate_) : 
+						chrono::milliseconds(0);
+					auto spent = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+					wait = wait > spent ? wait - spent : chrono::milliseconds(0);
+				}
+			}
+		}
+		unique_lock<mutex> lock(mutex_);
+		cv_stop_.wait_for(lock, wait, [this] { return stop_.load(); });
+	}
+}
+
+spill_stats SpillQueue::get_stats() {
+	spill_stats s;
+	s.spilled = spilled_;
+	s.replayed = replayed_;
+	s.replay_failed = replay_failed_;
+	lock_guard<mutex> lock(mutex_);
+	// the file being written counts once it has data; none before `open`
+	s.pending_files = next_seq_ - first_seq_;
+	if (s.pending_files && writer_ && !writer_bytes_) { --s.pending_files; }
+	return s;
+}
@@ -0,0 +1,89 @@
+#ifndef _SPILL_QUEUE_H_
+#define _SPILL_QUEUE_H_
+
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+#include "DBHandler.h"
+#include "Affinity.h"
+
+/* counters of a spill queue */
+struct spill_stats {
+	unsigned long long spilled;				/* records appended to spill files */
+	unsigned long long replayed;			/* records written back into storage */
+	unsigned long long replay_failed;		/* replay batches rejected by storage */
+	unsigned long long pending_files;		/* spill files not fully replayed */
+};
+
+/**
+	\description local append-only spill of records that could not be stored (failed
+	batches, overflowed queues); records are appended sequentially to `<dir>/spill-<seq>.bin`
+	files of at most `file_bytes`, and a replay thread writes them back into storage in
+	batches of `replay_batch`, at most `replay_rate` records per second, once the storage
+	accepts writes again. Only one batch is held in memory, whatever the outage length.
+	Replay progress is kept in `<dir>/spill.state`, fully replayed files are deleted. Task
+	names are spilled up to 1024 bytes
+*/
+class SpillQueue {
+	std::shared_ptr<StorageBackend> db_;
+	std::string dir_;
+	size_t file_bytes_;
+	size_t replay_batch_;
+	size_t replay_rate_;
+
+	std::mutex mutex_;						/* guards writer and state below */
+	FILE *writer_{ nullptr };				/* file `next_seq_ - 1` */
+	size_t writer_bytes_{ 0 };
+	unsigned long long first_seq_{ 0 };		/* oldest file not fully replayed */
+	unsigned long long next_seq_{ 0 };		/* sequence of next file to be created */
+	unsigned long long offset_{ 0 };		/* replayed bytes of file `first_seq_` */
+	std::function<bool()> busy_;
+
+	std::thread replayer_;
+	std::atomic<bool> stop_{ false };
+	std::condition_variable cv_stop_;
+	std::atomic<unsigned long long> spilled_{ 0 };
+	std::atomic<unsigned long long> replayed_{ 0 };
+	std::atomic<unsigned long long> replay_failed_{ 0 };
+
+	std::string file_name(unsigned long long seq);
+	bool save_state();
+	bool rotate();
+	void replay_loop();
+	/* replay one batch; returns number of records replayed, -1 if storage failed */
+	long long replay_batch();
+
+	SpillQueue(const SpillQueue&) = delete;
+	SpillQueue & operator = (const SpillQueue&) = delete;
+public:
+	SpillQueue(std::shared_ptr<StorageBackend> db, const std::string &dir, size_t file_bytes, 
+		size_t replay_batch, size_t replay_rate);
+	~SpillQueue() noexcept;
+	/**
+		create spill dir and load replay state of a previous run
+
+		@return bool				true if ready for `append`
+	*/
+	bool open();
+	/* start the replay thread, pinned to `cpus` if given */
+	void start(const cpu_list &cpus = cpu_list());
+	void stop();
+	/**
+		append a record; thread-safe, sequential write
+
+		@return bool				true if record was written to the spill file
+	*/
+	bool append(const StoreRecord &r);
+	/**
+		set predicate telling that live ingestion is under pressure; replay pauses meanwhile
+	*/
+	void set_busy(std::function<bool()> busy);
+	spill_stats get_stats();
+};
+
+#endif
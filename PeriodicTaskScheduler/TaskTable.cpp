@@ -0,0 +1,64 @@
+#include "TaskTable.h"
+#include "Affinity.h"
+using namespace PeriodicTaskScheduler;
+
+/*
+	implementation of \class TaskTable
+*/
+
+uint32_t TaskTable::insert(size_t tid, Clock::duration period, time_point deadline,
+	std::shared_ptr<TaskTiming> timing, std::shared_ptr<const std::string> name, Clock::duration phase) {
+	uint32_t slot;
+	if (!free_.empty()) {
+		slot = free_.back();
+		free_.pop_back();
+		cold_[slot] = task_slot_cold{ tid, timing, name, phase, NO_SLACK, deadline };
+	}
+	else {
+		slot = slots();
+		size_t capacity = deadline_.capacity();
+		deadline_.push_back(0);
+		period_.push_back(0);
+		state_.push_back(SLOT_FREE);
+		cold_.push_back(task_slot_cold{ tid, timing, name, phase, NO_SLACK, deadline });
+		if (slot % BLOCK == 0) { block_next_.push_back(ticks(time_point::max())); }
+		if (node_ >= 0 && deadline_.capacity() != capacity) { place(); }
+	}
+	period_[slot] = period.count();
+	state_[slot] = SLOT_ACTIVE;
+	set_deadline(slot, deadline);
+	++size_;
+	return slot;
+}
+
+void TaskTable::erase(uint32_t slot) {
+	state_[slot] = SLOT_FREE;
+	cold_[slot] = task_slot_cold();					/* release timing and name now */
+	free_.push_back(slot);
+	--size_;
+}
+
+void TaskTable::place() {
+	if (node_ < 0) return;
+	Affinity::prefer_node(deadline_.data(), deadline_.capacity() * sizeof(rep), node_);
+	Affinity::prefer_node(period_.data(), period_.capacity() * sizeof(rep), node_);
+	Affinity::prefer_node(state_.data(), state_.capacity(), node_);
+	Affinity::prefer_node(block_next_.data(), block_next_.capacity() * sizeof(rep), node_);
+}
+
+void TaskTable::refresh_block(size_t b) {
+	rep next = ticks(time_point::max());
+	uint32_t end = std::min<uint32_t>(static_cast<uint32_t>((b + 1) * BLOCK), slots());
+	for (uint32_t s = static_cast<uint32_t>(b * BLOCK); s < end; ++s) {
+		if (state_[s] == SLOT_ACTIVE && deadline_[s] < next) { next = deadline_[s]; }
+	}
+	block_next_[b] = next;
+}
+
+TaskTable::time_point TaskTable::next_deadline() const {
+	rep next = ticks(time_point::max());
+	for (rep b : block_next_) {
+		if (b < next) { next = b; }
+	}
+	return at(next);
+}
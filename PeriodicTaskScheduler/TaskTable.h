@@ -0,0 +1,146 @@
+#ifndef _TASK_TABLE_H_
+#define _TASK_TABLE_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <memory>
+#include "Clock.h"
+#include "Histogram.h"
+#include "Affinity.h"
+
+namespace PeriodicTaskScheduler {
+	const size_t CACHE_LINE = 64;
+
+	/* `T` alone on its cache line(s), for atomics written by other threads than the readers */
+	template <class T>
+	struct alignas(CACHE_LINE) cache_padded {
+		T value;
+	};
+
+	enum task_slot_state : uint8_t {
+		SLOT_FREE,
+		SLOT_ACTIVE,
+		SLOT_PAUSED
+	};
+
+	/* phase of a task that runs right away when added or resumed */
+	const Clock::duration NO_PHASE = Clock::duration(-1);
+
+	/**
+		\description tolerance of the start of a task: it may run up to `of(period)` before or
+		after its due time, so that the wakeups of tasks due close together are coalesced
+		into one (see `coalesce`); the larger of both parts counts
+	*/
+	struct task_slack {
+		float fraction;							/* of the period, e.g. .05f: +-5% */
+		Clock::duration absolute;
+
+		Clock::duration of(Clock::duration period) const {
+			auto relative = std::chrono::duration_cast<Clock::duration>(period * static_cast<double>(fraction));
+			return std::max(absolute, relative);
+		}
+	};
+	/* tasks start at their due time */
+	const task_slack NO_SLACK = task_slack{ 0.f, Clock::duration::zero() };
+
+	/* fields of a slot only needed by commands, results and metrics */
+	struct task_slot_cold {
+		size_t tid;
+		std::shared_ptr<TaskTiming> timing;
+		std::shared_ptr<const std::string> name;	/* shared with the result pipeline */
+		Clock::duration phase;					/* offset of executions within the period,
+												see `next_phase`; NO_PHASE if none */
+		task_slack slack;
+		Clock::time_point due;					/* of the next execution, before coalescing
+												into the deadline */
+	};
+
+	/**
+		\description table of periodic tasks in structure-of-arrays form: deadline, period
+		and state of each slot are held in dense arrays, cold fields apart. Slots
+		are grouped by BLOCK, and the earliest deadline of every block is kept in a summary
+		array, so that finding the due tasks reads one summary entry per block and the hot
+		arrays of due blocks only. A freed slot is reused by the next insert; the task id in
+		its cold fields tells the tasks of a slot apart. Not thread-safe
+	*/
+	class TaskTable {
+	public:
+		static const uint32_t BLOCK = 64;		/* slots per summary entry */
+		using time_point = Clock::time_point;
+		using rep = Clock::duration::rep;
+	private:
+		/* hot arrays, on pages of their own so that `set_node` moves nothing else */
+		std::vector<rep, PageAllocator<rep>> deadline_;	/* next execution, ticks of `Clock` */
+		std::vector<rep, PageAllocator<rep>> period_;	/* ticks of `Clock` */
+		std::vector<uint8_t, PageAllocator<uint8_t>> state_;	/* task_slot_state */
+		std::vector<rep, PageAllocator<rep>> block_next_;	/* earliest deadline of each block, 
+												may be earlier than the actual one, never later */
+		std::vector<task_slot_cold> cold_;
+		std::vector<uint32_t> free_;			/* freed slots, reused last first */
+		size_t size_{ 0 };						/* slots in use */
+		int node_{ -1 };						/* NUMA node of the hot arrays, -1: any */
+
+		static rep ticks(time_point t) { return t.time_since_epoch().count(); }
+		static time_point at(rep r) { return time_point(Clock::duration(r)); }
+		/* exact earliest deadline of the active slots of block `b` */
+		void refresh_block(size_t b);
+		/* prefer `node_` for the hot arrays, after they were reallocated */
+		void place();
+	public:
+		/**
+			@return uint32_t			slot of the new task, active, due and with deadline at 
+										`deadline`
+		*/
+		uint32_t insert(size_t tid, Clock::duration period, time_point deadline,
+			std::shared_ptr<TaskTiming> timing, std::shared_ptr<const std::string> name, 
+			Clock::duration phase = NO_PHASE);
+		void erase(uint32_t slot);
+		/* keep the hot arrays on NUMA node `node`, e.g. the node of the thread scanning them */
+		void set_node(int node) { node_ = node; place(); }
+		int node() const { return node_; }
+
+		size_t size() const { return size_; }
+		uint32_t slots() const { return static_cast<uint32_t>(state_.size()); }
+		task_slot_state state(uint32_t slot) const { return static_cast<task_slot_state>(state_[slot]); }
+		void set_state(uint32_t slot, task_slot_state s) { state_[slot] = s; }
+		Clock::duration period(uint32_t slot) const { return Clock::duration(period_[slot]); }
+		void set_period(uint32_t slot, Clock::duration period) { period_[slot] = period.count(); }
+		time_point deadline(uint32_t slot) const { return at(deadline_[slot]); }
+		void set_deadline(uint32_t slot, time_point t) {
+			deadline_[slot] = ticks(t);
+			rep &b = block_next_[slot / BLOCK];
+			if (ticks(t) < b) { b = ticks(t); }
+		}
+		const task_slot_cold &cold(uint32_t slot) const { return cold_[slot]; }
+		void set_phase(uint32_t slot, Clock::duration phase) { cold_[slot].phase = phase; }
+		void set_slack(uint32_t slot, const task_slack &slack) { cold_[slot].slack = slack; }
+		void set_due(uint32_t slot, time_point t) { cold_[slot].due = t; }
+		/* earliest deadline of all active tasks, time_point::max() if none */
+		time_point next_deadline() const;
+		/**
+			call `run(slot)` for every active slot due at `now`, in slot order; `run` sets the
+			next deadline of the slot, and must not insert or erase
+
+			@return time_point			earliest deadline afterwards
+		*/
+		template <class F>
+		time_point run_due(time_point now, F &&run) {
+			rep n = ticks(now), next = ticks(time_point::max());
+			for (size_t b = 0; b < block_next_.size(); ++b) {
+				if (block_next_[b] <= n) {
+					uint32_t end = std::min<uint32_t>(static_cast<uint32_t>((b + 1) * BLOCK), slots());
+					for (uint32_t s = static_cast<uint32_t>(b * BLOCK); s < end; ++s) {
+						if (state_[s] == SLOT_ACTIVE && deadline_[s] <= n) { run(s); }
+					}
+					refresh_block(b);
+				}
+				if (block_next_[b] < next) { next = block_next_[b]; }
+			}
+			return at(next);
+		}
+	};
+}
+
+#endif
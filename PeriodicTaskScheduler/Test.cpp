@@ -5,6 +5,7 @@
 #include "PeriodicTaskScheduler.h"
 #include "DBHandler.h"
 #include "works.h"
+#include "Logger.h"
 using namespace std;
 using namespace PeriodicTaskScheduler;
 
@@ -21,7 +22,7 @@ float work_3() {
 }
 
 int main(int argc, char **argv) {
-	setvbuf(stdout, nullptr, _IONBF, 0);
+	Logger::get().set_level(LOG_DEBUG);	/* show every task execution */
 
 	srand(time(nullptr));
 	auto scheduler = TaskScheduler::get();
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <algorithm>
+#include "Tracer.h"
+
+#pragma warning(disable: 4996 )
+
+using namespace std;
+
+namespace {
+	/* keeps the ring of a thread in the dump after the thread exits */
+	struct LocalTrace {
+		shared_ptr<TraceBuffer> buffer;		/* created on first event */
+		string name;						/* given before the first event */
+		~LocalTrace() { if (buffer) { buffer->retired.store(true); } }
+	};
+	thread_local LocalTrace local;
+
+	const char *COMMAND_NAMES[] = { "add_task", "update_task", "cancel_task", "start_tasks", "rebalance" };
+
+	void json_string(FILE *f, const string &s) {
+		fputc('"', f);
+		for (char c : s) {
+			if (static_cast<unsigned char>(c) < 0x20) {
+				fprintf(f, "\\u%04x", static_cast<unsigned>(c));	/* control characters */
+				continue;
+			}
+			if (c == '"' || c == '\\') { fputc('\\', f); }
+			fputc(c, f);
+		}
+		fputc('"', f);
+	}
+}
+
+/*
+	implementation of \class Tracer
+*/
+
+atomic<bool> Tracer::on_{ false };
+
+Tracer &Tracer::get() {
+	// never destroyed, threads may trace during static destruction
+	static Tracer *tracer = new Tracer();
+	return *tracer;
+}
+
+TraceBuffer *Tracer::local_buffer() {
+	if (!local.buffer) {
+		auto b = make_shared<TraceBuffer>();
+		size_t n = 1;
+		while (n < buffer_events_.load()) n <<= 1;
+		b->events.reset(new TraceEvent[n]);
+		b->mask = n - 1;
+		b->thread = next_thread_.fetch_add(1) + 1;
+		b->name = local.name.empty() ? "thread " + to_string(b->thread) : local.name;
+
+		lock_guard<mutex> lock(mu_buffers_);
+		// drop the oldest buffers of exited threads
+		size_t retired = 0;
+		for (auto &p : buffers_) { retired += p->retired.load() ? 1 : 0; }
+		for (auto it = buffers_.begin(); retired > MAX_RETIRED && it != buffers_.end(); ) {
+			if ((*it)->retired.load()) { it = buffers_.erase(it); --retired; }
+			else { ++it; }
+		}
+		buffers_.push_back(b);
+		local.buffer = b;
+	}
+	return local.buffer.get();
+}
+
+void Tracer::name_thread(const string &name) {
+	local.name = name;
+	if (local.buffer) {
+		lock_guard<mutex> lock(mu_buffers_);
+		local.buffer->name = name;
+	}
+}
+
+void Tracer::clear() {
+	lock_guard<mutex> lock(mu_buffers_);
+	buffers_.erase(remove_if(buffers_.begin(), buffers_.end(), 
+		[](const shared_ptr<TraceBuffer> &b) { return b->retired.load(); }), buffers_.end());
+	// rings of running threads are in use by their owners: hide their events instead
+	epoch_floor_.store(now_ns());
+}
+
+void Tracer::record(trace_event_type type, uint64_t id, uint32_t arg, uint64_t begin_ns,
+	uint64_t end_ns, uint8_t sub) {
+	TraceBuffer *b = local_buffer();
+	uint64_t h = b->head.load(memory_order_relaxed);
+	TraceEvent &e = b->events[h & b->mask];
+	e.begin_ns = begin_ns;
+	e.end_ns = end_ns;
+	e.id = id;
+	e.arg = arg;
+	e.type = type;
+	e.sub = sub;
+	b->head.store(h + 1, memory_order_release);
+}
+
+bool Tracer::dump_chrome_json(const string &path) {
+	FILE *f = fopen(path.c_str(), "w");
+	if (!f) {
+		return false;
+	}
+	vector<shared_ptr<TraceBuffer>> buffers;
+	vector<string> names;
+	{
+		lock_guard<mutex> lock(mu_buffers_);
+		buffers = buffers_;
+		for (auto &b : buffers) { names.push_back(b->name); }
+	}
+	uint64_t floor = epoch_floor_.load();
+
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+		"\"args\":{\"name\":\"PeriodicTaskScheduler\"}}");
+	vector<TraceEvent> events;
+	for (size_t i = 0; i < buffers.size(); ++i) {
+		TraceBuffer &b = *buffers[i];
+		uint32_t tid = b.thread;
+		fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", tid);
+		json_string(f, names[i]);
+		fprintf(f, "}}");
+
+		// copy, then discard events the owner may have overwritten meanwhile
+		uint64_t size = b.mask + 1;
+		uint64_t head = b.head.load(memory_order_acquire);
+		uint64_t first = head > size ? head - size : 0;
+		events.clear();
+		for (uint64_t k = first; k < head; ++k) { events.push_back(b.events[k & b.mask]); }
+		uint64_t after = b.head.load(memory_order_acquire);
+		size_t skip = after > size && after - size > first ?
+			static_cast<size_t>(min<uint64_t>(after - size - first, events.size())) : 0;
+
+		for (size_t k = skip; k < events.size(); ++k) {
+			const TraceEvent &e = events[k];
+			if (e.begin_ns < floor) continue;
+			double ts = e.begin_ns / 1e3, dur = (e.end_ns - e.begin_ns) / 1e3;
+			switch (e.type) {
+			case TRACE_DISPATCH:
+				fprintf(f, ",\n{\"name\":\"dispatch\",\"cat\":\"task\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+					"\"pid\":1,\"tid\":%u,\"args\":{\"task\":%llu,\"lateness_us\":%u}}",
+					ts, tid, static_cast<unsigned long long>(e.id), e.arg);
+				break;
+			case TRACE_WORK:
+				fprintf(f, ",\n{\"name\":\"work\",\"cat\":\"task\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+					"\"pid\":1,\"tid\":%u,\"args\":{\"task\":%llu}}",
+					ts, dur, tid, static_cast<unsigned long long>(e.id));
+				break;
+			case TRACE_DB_BATCH:
+				fprintf(f, ",\n{\"name\":\"db batch\",\"cat\":\"db\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+					"\"pid\":1,\"tid\":%u,\"args\":{\"records\":%u,\"stored\":%s}}",
+					ts, dur, tid, e.arg, e.id ? "true" : "false");
+				break;
+			case TRACE_COMMAND:
+				fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"scheduler\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+					"\"pid\":1,\"tid\":%u,\"args\":{\"task\":%llu,\"count\":%u}}",
+					COMMAND_NAMES[e.sub <= TRACE_CMD_REBALANCE ? e.sub : 0], ts, dur, tid,
+					static_cast<unsigned long long>(e.id), e.arg);
+				break;
+			case TRACE_PAUSE:
+			case TRACE_RESUME:
+				fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"task\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+					"\"pid\":1,\"tid\":%u,\"args\":{\"task\":%llu}}",
+					e.type == TRACE_PAUSE ? "pause" : "resume", ts, tid,
+					static_cast<unsigned long long>(e.id));
+				break;
+			}
+		}
+	}
+	fprintf(f, "\n]}\n");
+	bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#ifndef _TRACER_H_
+#define _TRACER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <chrono>
+
+enum trace_event_type : uint8_t {
+	TRACE_DISPATCH,						/* instant, task execution starts; arg: lateness us */
+	TRACE_WORK,							/* span of a work function */
+	TRACE_DB_BATCH,						/* span of `db_write`; arg: records, id: 1 if stored */
+	TRACE_COMMAND,						/* span of a scheduler command, see `trace_command` */
+	TRACE_PAUSE,						/* instant */
+	TRACE_RESUME						/* instant */
+};
+
+enum trace_command : uint8_t {
+	TRACE_CMD_ADD,
+	TRACE_CMD_UPDATE,
+	TRACE_CMD_CANCEL,
+	TRACE_CMD_START_TASKS,				/* scheduler thread starts new tasks; arg: count */
+	TRACE_CMD_REBALANCE					/* id 0; arg: tasks placed */
+};
+
+/* one binary event, 32 bytes */
+struct TraceEvent {
+	uint64_t begin_ns;					/* since `Tracer` creation */
+	uint64_t end_ns;					/* == begin_ns for instants */
+	uint64_t id;						/* task id, unless noted otherwise */
+	uint32_t arg;
+	uint8_t type;						/* trace_event_type */
+	uint8_t sub;						/* trace_command of TRACE_COMMAND */
+};
+
+/**
+	\description ring of the latest events of one thread; the owner overwrites the oldest
+	events and never waits
+*/
+struct TraceBuffer {
+	std::unique_ptr<TraceEvent[]> events;
+	uint64_t mask;						/* capacity - 1, capacity is a power of two */
+	std::atomic<uint64_t> head{ 0 };	/* events written so far */
+	std::atomic<bool> retired{ false };	/* owner thread exited */
+	uint32_t thread = 0;
+	std::string name;					/* thread name, guarded by `Tracer::mu_buffers_` */
+};
+
+/**
+	\description optional flight recorder of scheduler activity: task dispatch, work spans,
+	db batches, scheduler commands, pause/resume. While disabled every trace point costs one
+	relaxed load; when enabled, events are written into a ring of the calling thread (no lock)
+	and `dump_chrome_json` converts the rings into Chrome trace JSON (chrome://tracing,
+	ui.perfetto.dev) to see which tasks and threads ran when
+*/
+class Tracer {
+	static std::atomic<bool> on_;
+	std::chrono::steady_clock::time_point epoch_;
+	std::atomic<uint32_t> next_thread_{ 0 };
+	std::atomic<size_t> buffer_events_{ 1024 };	/* capacity of buffers created later */
+	std::atomic<uint64_t> epoch_floor_{ 0 };	/* events before are cleared */
+	std::mutex mu_buffers_;						/* guards `buffers_` and buffer names */
+	std::vector<std::shared_ptr<TraceBuffer>> buffers_;
+
+	Tracer() : epoch_(std::chrono::steady_clock::now()) {}
+	TraceBuffer *local_buffer();
+public:
+	enum { MAX_RETIRED = 256 };			/* buffers of exited threads kept for dumps */
+
+	static Tracer &get();
+	static bool on() { return on_.load(std::memory_order_relaxed); }
+	/**
+		enable/disable recording; events recorded so far are kept until `clear`
+	*/
+	void set_enabled(bool v) { on_.store(v); }
+	/**
+		capacity in events of rings created after this call, rounded up to a power of two
+	*/
+	void set_buffer_events(size_t n) { buffer_events_.store(n ? n : 1); }
+	/**
+		name the calling thread in dumps, e.g. "task 3"; no ring is allocated until the thread
+		records an event
+	*/
+	void name_thread(const std::string &name);
+	/**
+		drop all events recorded so far
+	*/
+	void clear();
+
+	uint64_t now_ns() const {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - epoch_).count());
+	}
+	void record(trace_event_type type, uint64_t id, uint32_t arg, uint64_t begin_ns,
+		uint64_t end_ns, uint8_t sub = 0);
+	/**
+		write the events of all threads as Chrome trace JSON
+
+		@return bool				false if `path` cannot be written
+	*/
+	bool dump_chrome_json(const std::string &path);
+};
+
+/* trace points; no-ops while tracing is disabled */
+inline void trace_instant(trace_event_type type, uint64_t id, uint32_t arg = 0) {
+	if (Tracer::on()) {
+		Tracer &t = Tracer::get();
+		uint64_t now = t.now_ns();
+		t.record(type, id, arg, now, now);
+	}
+}
+
+/* records a span from construction to destruction; `arg` may be set within the scope */
+class TraceScope {
+	uint64_t begin_;
+	trace_event_type type_;
+	uint8_t sub_;
+	uint64_t id_;
+public:
+	uint32_t arg;
+
+	TraceScope(trace_event_type type, uint64_t id, uint32_t arg = 0, uint8_t sub = 0) :
+		begin_(Tracer::on() ? Tracer::get().now_ns() : 0), type_(type), sub_(sub), id_(id),
+		arg(arg) {}
+	~TraceScope() {
+		if (begin_ && Tracer::on()) {
+			Tracer &t = Tracer::get();
+			t.record(type_, id_, arg, begin_, t.now_ns(), sub_);
+		}
+	}
+	void set_id(uint64_t id) { id_ = id; }
+	TraceScope(const TraceScope&) = delete;
+	TraceScope & operator=(const TraceScope&) = delete;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "WorkloadReplay.h"
+#include "Logger.h"
+using namespace PeriodicTaskScheduler;
+
+namespace {
+	/* recorded work durations of one task, consumed by its thread only */
+	struct replay_work {
+		vector<uint32_t> durations;			/* microseconds */
+		size_t next = 0;
+	};
+
+	/* a closure of 40 bytes, stored inline in the task */
+	auto make_work(shared_ptr<replay_work> w, clock_ptr clock, bool spin) {
+		return [w, clock, spin]() -> float {
+			uint32_t us = w->durations.empty() ? 0 : w->durations[w->next++ % w->durations.size()];
+			if (spin) {
+				auto end = steady_clock::now() + microseconds(us);
+				while (steady_clock::now() < end);
+			}
+			else if (us) {
+				clock->sleep_for(microseconds(us));
+			}
+			return us / 1000.f;
+		};
+	}
+}
+
+/*
+	implementation of \class WorkloadReplay
+*/
+
+bool WorkloadReplay::load(const string &path) {
+	if (!WorkloadRecorder::load(path.c_str(), events_, &header_)) {
+		log_error("load workload trace %s failed", path);
+		return false;
+	}
+	return true;
+}
+
+replay_report WorkloadReplay::run(task_scheduler_ptr s, const replay_config &cfg) {
+	replay_report r{};
+	auto clock = s->get_clock();
+	auto virtual_clock = dynamic_pointer_cast<VirtualClock>(clock);
+	bool spin = cfg.spin && !virtual_clock;
+
+	unordered_map<uint64_t, shared_ptr<replay_work>> works;	/* by recorded tid */
+	for (auto &e : events_) {
+		if (e.ev.op != WORKLOAD_WORK) continue;
+		auto &w = works[e.ev.tid];
+		if (!w) { w = make_shared<replay_work>(); }
+		w->durations.push_back(e.ev.value);
+		++r.recorded_executions;
+	}
+	unordered_map<uint64_t, task_handle> tids;				/* recorded -> replayed */
+	timing_snapshot before = s->get_timing();
+	auto real_start = steady_clock::now();
+	auto start = clock->now();
+
+	for (auto &e : events_) {
+		if (e.ev.op == WORKLOAD_WORK) continue;				/* replayed by the work functions */
+		auto at = start + duration_cast<Clock::duration>(microseconds(e.ev.time_us));
+		if (virtual_clock) { virtual_clock->advance_to(at); }
+		else { clock->sleep_until(at); }
+		if (e.ev.op == WORKLOAD_END) break;
+
+		++r.commands;
+		if (e.ev.op == WORKLOAD_ADD) {
+			auto &w = works[e.ev.tid];
+			if (!w) { w = make_shared<replay_work>(); }
+			task_handle h = s->add_task(microseconds(workload_value(e.ev)), make_work(w, clock, spin), e.name);
+			if (h.tid()) { tids[e.ev.tid] = h; ++r.tasks; }
+			else { ++r.skipped; }
+			continue;
+		}
+		auto it = tids.find(e.ev.tid);
+		if (it == tids.end()) {
+			++r.skipped;
+			continue;
+		}
+		switch (e.ev.op) {
+		case WORKLOAD_UPDATE: s->update_task(microseconds(workload_value(e.ev)), it->second); break;
+		case WORKLOAD_PAUSE: s->pause_task(it->second); break;
+		case WORKLOAD_RESUME: s->resume_task(it->second); break;
+		case WORKLOAD_CANCEL: s->cancel_task(it->second); tids.erase(it); break;
+		}
+	}
+	timing_snapshot after = s->get_timing();
+	r.elapsed_seconds = duration<double>(steady_clock::now() - real_start).count();
+	r.trace_seconds = events_.empty() ? 0 : events_.back().ev.time_us / 1e6;
+	r.lateness = after.lateness.since(before.lateness);
+	r.work = after.work.since(before.work);
+	r.executions = r.work.count;
+	for (auto &p : tids) { s->cancel_task(p.second); }
+	return r;
+}
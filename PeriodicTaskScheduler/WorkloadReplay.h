@@ -0,0 +1,54 @@
+#ifndef _WORKLOAD_REPLAY_H_
+#define _WORKLOAD_REPLAY_H_
+
+#include "PeriodicTaskScheduler.h"
+#include "WorkloadTrace.h"
+
+namespace PeriodicTaskScheduler {
+	/* how the work of a replayed task uses its recorded durations */
+	struct replay_config {
+		bool spin = false;					/* busy-wait instead of sleeping; ignored on a
+											`VirtualClock`, where work always sleeps */
+	};
+
+	/* outcome of a replay */
+	struct replay_report {
+		unsigned long long commands;		/* add/update/cancel/pause/resume replayed */
+		unsigned long long tasks;			/* tasks added */
+		unsigned long long skipped;			/* commands of tasks unknown to the trace */
+		unsigned long long recorded_executions;	/* executions in the trace */
+		unsigned long long executions;		/* executions during the replay */
+		double trace_seconds;				/* length of the trace */
+		double elapsed_seconds;				/* real time the replay took */
+		histogram_snapshot lateness;		/* of the replay only */
+		histogram_snapshot work;
+		/* executions per second of trace time */
+		double throughput() const { return trace_seconds > 0 ? executions / trace_seconds : 0; }
+	};
+
+	/**
+		\description re-drives a trace captured by `TaskScheduler::start_capture` against a
+		scheduler of any configuration (storage backend, pipeline, clock): every command is
+		issued at its recorded time, and the work of each task sleeps or spins for the
+		durations recorded for it, in order (restarting from the first once all were used)
+	*/
+	class WorkloadReplay {
+		vector<workload_record> events_;
+		workload_file_header header_{};
+	public:
+		/**
+			@return bool				false if `path` is not a workload trace
+		*/
+		bool load(const string &path);
+		size_t size() const { return events_.size(); }
+		/**
+			replay the loaded trace on `s`, which is set up and started; returns at the end
+			of the trace, after cancelling the replayed tasks. With a `VirtualClock` set on
+			`s` before, simulated time is advanced from command to command and the replay
+			runs faster than the trace
+		*/
+		replay_report run(task_scheduler_ptr s, const replay_config &cfg = replay_config());
+	};
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "WorkloadTrace.h"
+#include "Logger.h"
+
+#pragma warning(disable: 4996 )
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	implementation of \class WorkloadRecorder
+*/
+
+bool WorkloadRecorder::start(const char *path, shared_ptr<Clock> clock) {
+	lock_guard<mutex> lock(mu_);
+	if (file_) {
+		return false;
+	}
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		log_error("open workload trace %s failed", string(path));
+		return false;
+	}
+	clock_ = clock ? clock : Clock::system();
+	start_ = clock_->now();
+	workload_file_header h{ WORKLOAD_MAGIC, WORKLOAD_VERSION, clock_->unix_ms() };
+	fwrite(&h, sizeof(h), 1, f);
+	file_ = f;
+	events_ = 0;
+	on_.store(true);
+	return true;
+}
+
+void WorkloadRecorder::stop() {
+	if (!on_.exchange(false)) {
+		return;
+	}
+	lock_guard<mutex> lock(mu_);
+	if (!file_) {
+		return;
+	}
+	workload_event e{ static_cast<uint64_t>(duration_cast<microseconds>(clock_->now() - start_).count()),
+		0, 0, WORKLOAD_END, 0, 0 };
+	fwrite(&e, sizeof(e), 1, file_);
+	fclose(file_);
+	file_ = nullptr;
+	clock_ = nullptr;
+}
+
+unsigned long long WorkloadRecorder::events() {
+	lock_guard<mutex> lock(mu_);
+	return events_;
+}
+
+void WorkloadRecorder::write(uint8_t op, uint64_t tid, uint64_t value, const string *name) {
+	lock_guard<mutex> lock(mu_);
+	if (!file_) {
+		return;								/* stopped meanwhile */
+	}
+	// times are taken under the lock, so that events are written in time order
+	workload_event e{ static_cast<uint64_t>(duration_cast<microseconds>(clock_->now() - start_).count()),
+		tid, static_cast<uint32_t>(value), op, 0, static_cast<uint16_t>(value >> 32) };
+	if (name) { e.name_len = static_cast<uint8_t>(min<size_t>(name->size(), 255)); }
+	fwrite(&e, sizeof(e), 1, file_);
+	if (e.name_len) { fwrite(name->data(), 1, e.name_len, file_); }
+	++events_;
+}
+
+bool WorkloadRecorder::load(const char *path, vector<workload_record> &out,
+	workload_file_header *header) {
+	out.clear();
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		return false;
+	}
+	workload_file_header h;
+	if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != WORKLOAD_MAGIC || 
+		!h.version || h.version > WORKLOAD_VERSION) {
+		fclose(f);
+		return false;
+	}
+	if (header) { *header = h; }
+	workload_record r;
+	char name[256];
+	while (fread(&r.ev, sizeof(r.ev), 1, f) == 1) {
+		if (r.ev.name_len && fread(name, 1, r.ev.name_len, f) != r.ev.name_len) {
+			break;
+		}
+		r.name.assign(name, r.ev.name_len);
+		if (h.version < 3 && (r.ev.op == WORKLOAD_ADD || r.ev.op == WORKLOAD_UPDATE)) {
+			// periods were in seconds (version 1) or milliseconds (version 2)
+			uint64_t us = static_cast<uint64_t>(r.ev.value) * (h.version == 1 ? 1000000 : 1000);
+			r.ev.value = static_cast<uint32_t>(us);
+			r.ev.value_hi = static_cast<uint16_t>(us >> 32);
+		}
+		out.push_back(r);
+	}
+	fclose(f);
+	return true;
+}
@@ -0,0 +1,116 @@
+#ifndef _WORKLOAD_TRACE_H_
+#define _WORKLOAD_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include "Clock.h"
+
+/*
+	workload trace file: `workload_file_header` followed by `workload_event`s in time order;
+	the name of an added task (`name_len` bytes) follows its WORKLOAD_ADD event
+*/
+enum workload_op : uint8_t {
+	WORKLOAD_ADD,						/* value: period, in microseconds, see `workload_value`
+										(version 1: seconds, version 2: milliseconds) */
+	WORKLOAD_UPDATE,					/* value: new period */
+	WORKLOAD_CANCEL,
+	WORKLOAD_PAUSE,
+	WORKLOAD_RESUME,
+	WORKLOAD_WORK,						/* value: duration of one execution, in microseconds */
+	WORKLOAD_END						/* capture stopped */
+};
+
+const uint32_t WORKLOAD_MAGIC = 0x57535450;	/* "PTSW" */
+const uint32_t WORKLOAD_VERSION = 3;
+
+struct workload_file_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t unix_start_ms;				/* wall clock time of time_us 0 */
+};
+
+/* one event, 24 bytes */
+struct workload_event {
+	uint64_t time_us;					/* since start of capture */
+	uint64_t tid;						/* task id of the recording scheduler */
+	uint32_t value;						/* see `workload_op` */
+	uint8_t op;							/* workload_op */
+	uint8_t name_len;
+	uint16_t value_hi;					/* bits 32-47 of a period, 0 otherwise */
+};
+
+/* value of `e` with its high bits: periods beyond 2^32us (~71 minutes) */
+inline uint64_t workload_value(const workload_event &e) {
+	return e.value | static_cast<uint64_t>(e.value_hi) << 32;
+}
+
+/* loaded event, with the name of WORKLOAD_ADD */
+struct workload_record {
+	workload_event ev;
+	std::string name;
+};
+
+/**
+	\description capture of the control-plane commands of a scheduler (add, update, cancel,
+	pause, resume) and of the work duration of every execution, into a compact binary file
+	to be replayed offline by `WorkloadReplay`. While not capturing each record call costs
+	one relaxed load; while capturing, events are appended under a lock through a stdio
+	buffer
+*/
+class WorkloadRecorder {
+	std::atomic<bool> on_{ false };
+	std::mutex mu_;							/* guards everything below */
+	FILE *file_{ nullptr };
+	std::shared_ptr<Clock> clock_;
+	Clock::time_point start_;
+	unsigned long long events_{ 0 };
+
+	void write(uint8_t op, uint64_t tid, uint64_t value, const std::string *name = nullptr);
+	/* period as recorded: whole microseconds, at least 1, at most 48 bits */
+	static uint64_t period_us(Clock::duration period) {
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(period).count();
+		return us < 1 ? 1 : us > 0xffffffffffffll ? 0xffffffffffffull : static_cast<uint64_t>(us);
+	}
+public:
+	~WorkloadRecorder() noexcept { stop(); }
+	/**
+		start writing into `path` (truncated), with times from `clock`
+
+		@return bool				false if `path` cannot be written or already capturing
+	*/
+	bool start(const char *path, std::shared_ptr<Clock> clock);
+	/* append WORKLOAD_END and close the file */
+	void stop();
+	bool enabled() const { return on_.load(std::memory_order_relaxed); }
+	unsigned long long events();
+
+	void record_add(uint64_t tid, Clock::duration period, const std::string &name) {
+		if (enabled()) write(WORKLOAD_ADD, tid, period_us(period), &name);
+	}
+	void record_update(uint64_t tid, Clock::duration period) {
+		if (enabled()) write(WORKLOAD_UPDATE, tid, period_us(period));
+	}
+	void record_cancel(uint64_t tid) { if (enabled()) write(WORKLOAD_CANCEL, tid, 0); }
+	void record_pause(uint64_t tid) { if (enabled()) write(WORKLOAD_PAUSE, tid, 0); }
+	void record_resume(uint64_t tid) { if (enabled()) write(WORKLOAD_RESUME, tid, 0); }
+	void record_work(uint64_t tid, unsigned long long us) {
+		if (enabled()) write(WORKLOAD_WORK, tid, static_cast<uint32_t>(us < 0xffffffffull ? us : 0xffffffffull));
+	}
+
+	/**
+		read a trace written by `start`/`stop`; a trace cut short (no WORKLOAD_END) is
+		read up to its last complete event. Periods of version 1 and 2 traces are converted to
+		microseconds
+
+		@return bool				false if `path` is not a workload trace
+	*/
+	static bool load(const char *path, std::vector<workload_record> &out,
+		workload_file_header *header = nullptr);
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "PeriodicTaskScheduler.h"
+#include "WorkloadReplay.h"
+#include "SegmentStore.h"
+#include "Logger.h"
+
+#pragma warning(disable: 4996 )
+
+using namespace std;
+using namespace PeriodicTaskScheduler;
+
+/*
+	replays a workload trace captured with `TaskScheduler::start_capture` against a
+	scheduler configured from the command line, and reports lateness and throughput
+*/
+
+namespace {
+	/* accepts and drops every result */
+	class NullBackend : public StorageBackend {
+	public:
+		virtual bool db_setup() { return true; }
+		virtual bool db_insert(size_t, const char*, float) { return true; }
+		virtual bool db_write(const StoreRecord*, size_t) { return true; }
+	};
+
+	/* "null", "sqlite:<file>" or "segment:<dir>" */
+	db_handler_ptr make_store(const string &spec) {
+		static string sqlite_file;				/* SQLiteHandler keeps the pointer */
+		if (spec == "null") return make_shared<NullBackend>();
+		if (!spec.compare(0, 7, "sqlite:")) {
+			sqlite_file = spec.substr(7);
+			return db_handler_ptr(new SQLiteHandler(sqlite_file.c_str()));
+		}
+		if (!spec.compare(0, 8, "segment:")) return make_shared<SegmentStore>(spec.c_str() + 8);
+		return nullptr;
+	}
+
+	void print_histogram(FILE *out, const char *name, const histogram_snapshot &h) {
+		fprintf(out, "  \"%s_us\": {\"count\": %llu, \"mean\": %.1f, \"p50\": %llu, \"p99\": %llu, "
+			"\"p999\": %llu, \"max\": %llu}", name, h.count, h.mean(), h.percentile(50),
+			h.percentile(99), h.percentile(99.9), h.max);
+	}
+}
+
+/**
+	usage: Replay <trace> [--clock=real|virtual] [--work=sleep|spin]
+		[--store=null|sqlite:<file>|segment:<dir>] [--result_queue=<n>] [--max_batch=<n>]
+		[--out=<file.json>]
+	prints the report as JSON to stdout, or to `--out`
+*/
+int main(int argc, char **argv) {
+	string trace, store = "null", out_path;
+	bool virtual_time = false, usage = false;
+	replay_config cfg;
+	pipeline_config pcfg;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--clock=virtual")) virtual_time = true;
+		else if (!strcmp(argv[i], "--clock=real")) virtual_time = false;
+		else if (!strcmp(argv[i], "--work=spin")) cfg.spin = true;
+		else if (!strcmp(argv[i], "--work=sleep")) cfg.spin = false;
+		else if (!strncmp(argv[i], "--store=", 8)) store = argv[i] + 8;
+		else if (!strncmp(argv[i], "--result_queue=", 15)) pcfg.result_capacity = atoi(argv[i] + 15);
+		else if (!strncmp(argv[i], "--max_batch=", 12)) pcfg.max_batch = atoi(argv[i] + 12);
+		else if (!strncmp(argv[i], "--out=", 6)) out_path = argv[i] + 6;
+		else if (argv[i][0] != '-' && trace.empty()) trace = argv[i];
+		else usage = true;
+	}
+	db_handler_ptr db = make_store(store);
+	if (usage || trace.empty() || !db) {
+		fprintf(stderr, "usage: %s <trace> [--clock=real|virtual] [--work=sleep|spin] "
+			"[--store=null|sqlite:<file>|segment:<dir>] [--result_queue=<n>] [--max_batch=<n>] "
+			"[--out=<file>]\n", argv[0]);
+		return 1;
+	}
+	WorkloadReplay replay;
+	if (!replay.load(trace)) {
+		return 1;
+	}
+	Logger::get().set_level(LOG_WARN);			/* no per-task lifecycle lines */
+	auto scheduler = TaskScheduler::get();
+	if (virtual_time) { scheduler->set_clock(make_shared<VirtualClock>()); }
+	if (!scheduler->setup_context(db, pcfg)) {
+		return 1;
+	}
+	scheduler->start();
+	replay_report r = replay.run(scheduler, cfg);
+	scheduler->release_context();
+
+	FILE *out = out_path.empty() ? stdout : fopen(out_path.c_str(), "w");
+	if (!out) {
+		fprintf(stderr, "open %s failed\n", out_path.c_str());
+		return 1;
+	}
+	fprintf(out, "{\n  \"trace\": \"%s\", \"clock\": \"%s\", \"work\": \"%s\", \"store\": \"%s\",\n",
+		trace.c_str(), virtual_time ? "virtual" : "real", cfg.spin ? "spin" : "sleep", store.c_str());
+	fprintf(out, "  \"commands\": %llu, \"tasks\": %llu, \"skipped\": %llu,\n",
+		r.commands, r.tasks, r.skipped);
+	fprintf(out, "  \"recorded_executions\": %llu, \"executions\": %llu, \"executions_per_sec\": %.2f,\n",
+		r.recorded_executions, r.executions, r.throughput());
+	fprintf(out, "  \"trace_seconds\": %.3f, \"elapsed_seconds\": %.3f,\n",
+		r.trace_seconds, r.elapsed_seconds);
+	print_histogram(out, "lateness", r.lateness);
+	fprintf(out, ",\n");
+	print_histogram(out, "work", r.work);
+	fprintf(out, "\n}\n");
+	if (out != stdout) { fclose(out); }
+	return 0;
+}